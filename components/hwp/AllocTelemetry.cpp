@@ -0,0 +1,169 @@
+/**
+ * @file AllocTelemetry.cpp
+ * @brief Implementation of the allocation telemetry and of the operator new hook.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "AllocTelemetry.h"
+
+#include <cstdlib>
+#include <new>
+
+#include <esp_heap_caps.h>
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace hwp {
+
+AllocTelemetry::atomic_counter_t AllocTelemetry::contexts_[ALLOC_CONTEXT_COUNT] = {};
+AllocTelemetry::atomic_counter_t AllocTelemetry::sites_[ALLOC_SITE_COUNT] = {};
+TaskHandle_t AllocTelemetry::tasks_[AllocTelemetry::max_tasks] = {};
+alloc_context_t AllocTelemetry::task_contexts_[AllocTelemetry::max_tasks] = {};
+std::atomic<size_t> AllocTelemetry::tasks_count_{0};
+thread_local alloc_site_t AllocTelemetry::current_site_ = ALLOC_SITE_NONE;
+
+void AllocTelemetry::register_task(alloc_context_t context, TaskHandle_t handle) {
+    size_t count = tasks_count_.load();
+    for (size_t i = 0; i < count; i++) {
+        if (tasks_[i] == handle) {
+            task_contexts_[i] = context;
+            return;
+        }
+    }
+    if (count >= max_tasks) return;
+    tasks_[count] = handle;
+    task_contexts_[count] = context;
+    // publish the entry only once it is filled, record() may run concurrently
+    tasks_count_.store(count + 1);
+}
+
+void AllocTelemetry::record(size_t size) {
+    alloc_context_t context = ALLOC_CONTEXT_OTHER;
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    size_t count = tasks_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; current != nullptr && i < count; i++) {
+        if (tasks_[i] == current) {
+            context = task_contexts_[i];
+            break;
+        }
+    }
+    contexts_[context].count.fetch_add(1, std::memory_order_relaxed);
+    contexts_[context].bytes.fetch_add(size, std::memory_order_relaxed);
+    sites_[current_site_].count.fetch_add(1, std::memory_order_relaxed);
+    sites_[current_site_].bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+alloc_counter_t AllocTelemetry::get_context(alloc_context_t context) {
+    return load(contexts_[context]);
+}
+
+alloc_counter_t AllocTelemetry::get_site(alloc_site_t site) { return load(sites_[site]); }
+
+heap_snapshot_t AllocTelemetry::get_heap() {
+    return {static_cast<uint32_t>(heap_caps_get_free_size(MALLOC_CAP_8BIT)),
+        static_cast<uint32_t>(heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT)),
+        static_cast<uint32_t>(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT))};
+}
+
+const char* AllocTelemetry::context_name(alloc_context_t context) {
+    switch (context) {
+    case ALLOC_CONTEXT_MAIN:
+        return "main loop";
+    case ALLOC_CONTEXT_RX:
+        return "rx";
+    default:
+        return "other";
+    }
+}
+
+const char* AllocTelemetry::site_name(alloc_site_t site) {
+    switch (site) {
+    case ALLOC_SITE_FRAME_PROCESS:
+        return "BaseFrame::process";
+    case ALLOC_SITE_DECODER_DEBUG:
+        return "Decoder::debug";
+    case ALLOC_SITE_CS:
+        return "CS";
+    case ALLOC_SITE_SPINLOCK_QUEUE:
+        return "SpinLockQueue";
+    case ALLOC_SITE_HEATER_STATUS:
+        return "HeaterStatus";
+    default:
+        return "unscoped";
+    }
+}
+
+void AllocTelemetry::log_report(const char* tag) {
+    heap_snapshot_t heap = get_heap();
+    ESP_LOGCONFIG(tag, "      - heap: %u free, %u min free, %u largest block", heap.free_bytes,
+        heap.min_free_bytes, heap.largest_free_block);
+    if (!is_enabled()) return;
+    for (size_t i = 0; i < ALLOC_CONTEXT_COUNT; i++) {
+        alloc_counter_t counter = get_context(static_cast<alloc_context_t>(i));
+        ESP_LOGCONFIG(tag, "      - allocations from %s: %u (%u bytes)",
+            context_name(static_cast<alloc_context_t>(i)), counter.count, counter.bytes);
+    }
+    for (size_t i = 0; i < ALLOC_SITE_COUNT; i++) {
+        alloc_counter_t counter = get_site(static_cast<alloc_site_t>(i));
+        ESP_LOGCONFIG(tag, "      - allocations in %s: %u (%u bytes)",
+            site_name(static_cast<alloc_site_t>(i)), counter.count, counter.bytes);
+    }
+}
+
+} // namespace hwp
+} // namespace esphome
+
+#ifdef USE_HWP_ALLOC_TELEMETRY
+// Replacing the global operators is the only way to see the allocations made by the standard
+// library (strings, streams, containers) on behalf of the hwp code.
+static void* hwp_counted_alloc(size_t size) {
+    esphome::hwp::AllocTelemetry::record(size);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) abort();
+    return ptr;
+}
+void* operator new(size_t size) { return hwp_counted_alloc(size); }
+void* operator new[](size_t size) { return hwp_counted_alloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    esphome::hwp::AllocTelemetry::record(size);
+    return malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    esphome::hwp::AllocTelemetry::record(size);
+    return malloc(size == 0 ? 1 : size);
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file AllocTelemetry.h
+ * @brief Allocation and heap fragmentation telemetry for the hwp component.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "esphome/core/defines.h"
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @enum alloc_context_t
+ * @brief The task an allocation was made from.
+ */
+typedef enum {
+    ALLOC_CONTEXT_MAIN,  ///< ESPHome main loop (all components, not only hwp)
+    ALLOC_CONTEXT_RX,    ///< Decode worker, which also runs the transmitters
+    ALLOC_CONTEXT_OTHER, ///< Any other task, or before the scheduler started
+    ALLOC_CONTEXT_COUNT
+} alloc_context_t;
+
+/**
+ * @enum alloc_site_t
+ * @brief The hwp code path an allocation was made from, set with HWP_ALLOC_SCOPE.
+ */
+typedef enum {
+    ALLOC_SITE_NONE,
+    ALLOC_SITE_FRAME_PROCESS,
+    ALLOC_SITE_DECODER_DEBUG,
+    ALLOC_SITE_CS,
+    ALLOC_SITE_SPINLOCK_QUEUE,
+    ALLOC_SITE_HEATER_STATUS,
+    ALLOC_SITE_COUNT
+} alloc_site_t;
+
+typedef struct {
+    uint32_t count; ///< Number of allocations
+    uint32_t bytes; ///< Total bytes requested
+} alloc_counter_t;
+
+typedef struct {
+    uint32_t free_bytes;         ///< Free internal heap right now
+    uint32_t min_free_bytes;     ///< Lowest free internal heap since boot
+    uint32_t largest_free_block; ///< Largest block that can be allocated right now
+} heap_snapshot_t;
+
+/**
+ * @class AllocTelemetry
+ * @brief Counts operator new calls per task and per hwp code path.
+ *
+ * The counters are only fed when the component is built with USE_HWP_ALLOC_TELEMETRY, in
+ * which case AllocTelemetry.cpp replaces the global operator new. Everything allocated with
+ * new is then counted, so the main loop context also includes other components; the site
+ * counters narrow it down to the hwp paths that are known to allocate. The heap snapshot
+ * does not depend on the build flag.
+ */
+class AllocTelemetry {
+  public:
+    static constexpr size_t max_tasks = 8;
+
+    static constexpr bool is_enabled() {
+#ifdef USE_HWP_ALLOC_TELEMETRY
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Attributes the allocations made by a task to the given context.
+     */
+    static void register_task(alloc_context_t context, TaskHandle_t handle);
+    /**
+     * @brief Records an allocation made by the current task, in the current scope.
+     */
+    static void record(size_t size);
+
+    static alloc_counter_t get_context(alloc_context_t context);
+    static alloc_counter_t get_site(alloc_site_t site);
+    static heap_snapshot_t get_heap();
+    static const char* context_name(alloc_context_t context);
+    static const char* site_name(alloc_site_t site);
+    /**
+     * @brief Logs the counters of every context and site, and the heap state.
+     */
+    static void log_report(const char* tag);
+
+    static alloc_site_t get_site() { return current_site_; }
+    static void set_site(alloc_site_t site) { current_site_ = site; }
+
+  protected:
+    typedef struct {
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> bytes;
+    } atomic_counter_t;
+
+    static atomic_counter_t contexts_[ALLOC_CONTEXT_COUNT];
+    static atomic_counter_t sites_[ALLOC_SITE_COUNT];
+    static TaskHandle_t tasks_[max_tasks];
+    static alloc_context_t task_contexts_[max_tasks];
+    static std::atomic<size_t> tasks_count_;
+    static thread_local alloc_site_t current_site_;
+
+    static alloc_counter_t load(const atomic_counter_t& counter) {
+        return {counter.count.load(std::memory_order_relaxed),
+            counter.bytes.load(std::memory_order_relaxed)};
+    }
+};
+
+/**
+ * @brief Attributes the allocations made while in scope to a code path.
+ */
+class AllocScope {
+  public:
+    explicit AllocScope(alloc_site_t site) : previous_(AllocTelemetry::get_site()) {
+        AllocTelemetry::set_site(site);
+    }
+    ~AllocScope() { AllocTelemetry::set_site(this->previous_); }
+
+  protected:
+    alloc_site_t previous_;
+};
+
+#ifdef USE_HWP_ALLOC_TELEMETRY
+#define HWP_ALLOC_SCOPE(site) esphome::hwp::AllocScope hwp_alloc_scope_(site)
+#else
+#define HWP_ALLOC_SCOPE(site)
+#endif
+
+} // namespace hwp
+} // namespace esphome
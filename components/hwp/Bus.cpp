@@ -31,6 +31,7 @@
  * for any damage or loss caused by the use of this software.
  */
 #include "Bus.h"
+#include <algorithm>
 #include <memory>
 
 #include "HPUtils.h"
@@ -39,6 +40,7 @@
 #include "esphome/core/log.h"
 
 #ifdef USE_ESP32
+#include <esp_random.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
@@ -53,6 +55,8 @@
 namespace esphome {
 namespace hwp {
 const uint8_t default_frame_transmit_count = 8;
+// how often readiness is re-evaluated while transmissions are not armed yet
+static constexpr uint32_t tx_ready_poll_ms = 250;
 // max duration would be all bits having their longest duration, plus the frame spacing and
 // frame heading
 const uint32_t single_frame_max_duration_ms =
@@ -60,9 +64,12 @@ const uint32_t single_frame_max_duration_ms =
     controler_frame_spacing_duration_ms + frame_heading_total_duration_ms;
 
 Bus::Bus(size_t maxWriteLength, size_t transmitCount)
-    : mode(BUSMODE_RX), TxTaskHandle(nullptr), RxTaskHandle(nullptr), transmit_count(transmitCount),
+    : mode(BUSMODE_RX), transmit_count(transmitCount),
       // maxBufferCount(maxBufferCount),
-      maxWriteLength(maxWriteLength), tx_packets_queue(maxWriteLength) {}
+      maxWriteLength(maxWriteLength), tx_packets_queue(maxWriteLength),
+      scheduler_(delay_between_controller_messages_ms, single_frame_max_duration_ms) {
+    this->tx_packets_queue.set_tracker(&this->command_tracker_);
+}
 
 void Bus::setup() {
     this->current_frame.reset("From setup");
@@ -82,6 +89,7 @@ void IRAM_ATTR Bus::process_pulse(rmt_item32_t* item) {
                 ESP_LOGV(TAG_BUS, "Invalid length");
             } else if (this->current_frame.is_size_valid()) {
                 this->current_frame.debug("Starting new frame");
+                this->recover_failed_copy();
             } else if (!this->current_frame.is_checksum_valid()) {
                 ESP_LOGV(TAG_BUS, "Invalid checksum");
                 BaseFrame inv_bf = BaseFrame(this->current_frame);
@@ -95,13 +103,21 @@ void IRAM_ATTR Bus::process_pulse(rmt_item32_t* item) {
         // log the frame start
         this->log_pulse_item(item);
         this->current_frame.start_new_frame();
+        this->glitch_pending_ = false;
+        this->frame_glitches_ = 0;
+        this->frame_duration_us_ =
+            Decoder::get_low_duration(item) + Decoder::get_high_duration(item);
     } else {
         if (this->current_frame.is_started()) {
+            if (this->glitch_pending_ && this->resolve_glitch(item)) return;
             bool is_long = Decoder::is_long_bit(item);
             bool is_short = Decoder::is_short_bit(item);
             if (is_long || is_short) {
                 // Long bit detected
-                this->current_frame.append_bit(is_long);
+                this->current_frame.append_bit(is_long, Decoder::get_bit_margin(item, is_long));
+                this->frame_duration_us_ +=
+                    Decoder::get_low_duration(item) + Decoder::get_high_duration(item);
+                this->frame_last_edge_clock_us_ = this->rx_clock_us_;
             } else {
                 if (Decoder::is_frame_end(item)) {
                     if (this->current_frame.is_complete()) {
@@ -115,12 +131,18 @@ void IRAM_ATTR Bus::process_pulse(rmt_item32_t* item) {
                     if (this->current_frame.is_complete()) {
                         this->finalize_frame(true);
                         this->reset_pulse_log();
+                    } else if (this->frame_glitches_ < max_frame_glitches) {
+                        // hold it, the next pulse tells whether it can be merged
+                        this->frame_glitches_++;
+                        this->glitch_pulse_ = *item;
+                        this->glitch_pending_ = true;
                     } else {
                         // Invalid length, possibly due to collisions
                         ESP_LOGV(TAG_BUS, "Invalid pulse length detected (1:%dus/0:%d)",
                             Decoder::get_high_duration(item), Decoder::get_low_duration(item));
                         if (this->current_frame.is_size_valid()) {
                             this->current_frame.debug("Invalid frame - ");
+                            this->recover_failed_copy();
                         }
                         this->current_frame.reset("Invalid pulse and invalid frame");
                         this->log_pulses();
@@ -131,10 +153,60 @@ void IRAM_ATTR Bus::process_pulse(rmt_item32_t* item) {
     }
 }
 
+static rmt_item32_t make_bit_pulse(uint32_t low_us, uint32_t high_us) {
+    rmt_item32_t pulse{};
+    pulse.level0 = 0;
+    pulse.duration0 = std::min<uint32_t>(low_us, rx_edge_max_duration_us);
+    pulse.level1 = 1;
+    pulse.duration1 = std::min<uint32_t>(high_us, rx_edge_max_duration_us);
+    return pulse;
+}
+
+bool Bus::resolve_glitch(rmt_item32_t* item) {
+    this->glitch_pending_ = false;
+    uint32_t glitch_low = Decoder::get_low_duration(&this->glitch_pulse_);
+    uint32_t glitch_high = Decoder::get_high_duration(&this->glitch_pulse_);
+    uint32_t low = Decoder::get_low_duration(item);
+    uint32_t high = Decoder::get_high_duration(item);
+    // A spike to low during a high level splits the bit high time, a spike to high during a
+    // low level splits its low time. Either way, the two pulses together make one bit.
+    rmt_item32_t candidates[] = {
+        make_bit_pulse(glitch_low, glitch_high + low + high),
+        make_bit_pulse(glitch_low + glitch_high + low, high),
+    };
+    for (auto& merged : candidates) {
+        bool is_long = Decoder::is_long_bit(&merged);
+        if (is_long || Decoder::is_short_bit(&merged)) {
+            ESP_LOGV(TAG_BUS, "Glitch merged into a %s bit", is_long ? "long" : "short");
+            // no timing margin left, a repair may flip it first
+            this->current_frame.append_bit(is_long, 0);
+            this->frame_duration_us_ += glitch_low + glitch_high + low + high;
+            this->frame_last_edge_clock_us_ = this->rx_clock_us_;
+            this->rx_stats_.glitches_merged++;
+            return true;
+        }
+    }
+    // The glitch stands for one bit that could not be read: keep the closest value and mark it
+    // as an erasure for the burst vote or the repair, then decode the new pulse as usual.
+    uint32_t boundary_us = (bit_long_high_duration_ms + bit_short_high_duration_ms) * 1000 / 2;
+    this->current_frame.append_bit(glitch_high >= boundary_us, 0);
+    this->frame_duration_us_ += glitch_low + glitch_high;
+    this->rx_stats_.erasures++;
+    ESP_LOGV(TAG_BUS, "Glitch kept as an erasure (1:%uus/0:%uus)", glitch_high, glitch_low);
+    return false;
+}
+
 bool Bus::queue_frame_data(std::shared_ptr<BaseFrame> frame) {
     ESP_LOGD(TAG_BUS, "Queueing frame data for transmission");
-    tx_packets_queue.enqueue(frame);
-    return true;
+    switch (this->tx_packets_queue.enqueue(frame, millis())) {
+    case TX_ENQUEUE_MERGED:
+        ESP_LOGD(TAG_BUS, "Frame coalesced with a pending %s frame", frame->type_string());
+        return true;
+    case TX_ENQUEUE_REJECTED:
+        return false;
+    default:
+        return true;
+    }
 }
 void Bus::start_receive() {
     this->current_frame.reset();
@@ -143,20 +215,44 @@ void Bus::start_receive() {
 
     } else {
         ESP_LOGI(TAG_BUS, "Starting reception on pin %d", this->gpio_pin_->get_pin());
+        if (this->rb_ == nullptr) {
+            // the ring buffer and the worker must exist before the ISR can fire
+            this->rb_ = xRingbufferCreate(rx_ring_size, RINGBUF_TYPE_BYTEBUF);
+            ESP_LOGD(TAG_BUS, "Created ring buffer with size %u (%u edges)", rx_ring_size,
+                rx_ring_size / sizeof(rx_edge_t));
+            const esp_timer_create_args_t timer_args = {.callback = &Bus::frame_end_timer_cb,
+                .arg = this,
+                .dispatch_method = ESP_TIMER_TASK,
+                .name = "hwp_frame_end",
+                .skip_unhandled_events = true};
+            if (esp_timer_create(&timer_args, &this->frame_end_timer_) != ESP_OK) {
+                ESP_LOGW(TAG_BUS, "No frame end timer, frames will end on the worker poll");
+                this->frame_end_timer_ = nullptr;
+            }
+            const esp_timer_create_args_t step_args = {.callback = &Bus::tx_step_timer_cb,
+                .arg = this,
+                .dispatch_method = ESP_TIMER_TASK,
+                .name = "hwp_tx_step",
+                .skip_unhandled_events = false};
+            if (esp_timer_create(&step_args, &this->tx_step_timer_) != ESP_OK) {
+                ESP_LOGW(TAG_BUS, "No TX step timer, frames will be sent from the bus task");
+                this->tx_step_timer_ = nullptr;
+            }
+            ESP_LOGD(TAG_BUS, "Waiting for the bus timeline to be known before transmitting");
+            this->tx_start_ms_ = millis();
+            if (!DecodeWorker::add_bus(this, &this->worker_index_)) {
+                ESP_LOGE(TAG_BUS, "Unable to decode pin %d", this->gpio_pin_->get_pin());
+            }
+            this->tx_packets_queue.set_task_handle(DecodeWorker::get_task_handle());
+        }
         this->gpio_pin_->pin_mode(gpio::Flags::FLAG_PULLUP | gpio::Flags::FLAG_INPUT);
+        this->isr_pin_ = this->gpio_pin_->to_isr();
+        // last_change_us_ still holds the last edge received, date the frame before it moves
+        if (this->frame_timing_.pending) this->report_frame_timing();
+        this->last_change_us_ = static_cast<uint32_t>(esp_timer_get_time());
         this->gpio_pin_->attach_interrupt(&Bus::isr_handler, this, gpio::INTERRUPT_ANY_EDGE);
+        this->tx_level_target_us_ = 0; // the line is released, nothing more to time
         // reset the change detection to what's now on the bus
-
-        if (this->RxTaskHandle == nullptr) {
-            size_t ring_buf_size = 12 * frame_data_length * (8 + 2) * sizeof(rmt_item32_t);
-            this->rb_ = xRingbufferCreate(ring_buf_size, RINGBUF_TYPE_NOSPLIT);
-            ESP_LOGD(TAG_BUS, "Created ring buffer with size %u (frame data length %u)",
-                ring_buf_size, frame_data_length);
-
-            ESP_LOGD(TAG_BUS, "Creating io Tasks");
-            xTaskCreate(RxTask, "RX", 1024 * 11, this, 1, &this->RxTaskHandle);
-            xTaskCreate(TxTask, "TX", 1024 * 15, this, 1, &this->TxTaskHandle);
-        }
         this->current_frame.reset();
         this->reset_pulse_log();
         ESP_LOGI(TAG_BUS, "Done Starting reception on pin %d", this->gpio_pin_->get_pin());
@@ -167,125 +263,456 @@ void Bus::start_receive() {
 void IRAM_ATTR Bus::isr_handler(Bus* instance) { instance->isr_handler(); }
 
 void IRAM_ATTR Bus::isr_handler() {
+    uint32_t start_cycles = arch_get_cpu_cycle_count();
     portBASE_TYPE HPTaskAwoken = pdFALSE;
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    bool level = this->isr_pin_.digital_read();
     if (this->mode == BUSMODE_TX) {
+        // only attached while sending with readback: once the pull-up had time to raise the
+        // line we released, a low level comes from someone else
+        if (!level && this->tx_readback_ && !this->tx_driving_low_ &&
+            now - this->tx_level_start_us_ >= readback_settle_us) {
+            this->tx_collision_ = true;
+        }
         return;
     }
 
-    uint64_t now = esp_timer_get_time();
-    bool level = this->gpio_pin_->digital_read();
+    uint32_t duration = this->elapsed(now);
+    rx_edge_t edge = (level ? 0 : rx_edge_level_bit) |
+                     static_cast<rx_edge_t>(std::min<uint32_t>(duration, rx_edge_max_duration_us));
 
-    if (this->current_pulse_.duration0 == 0 && level) {
-        this->current_pulse_.level0 = !level;
-        this->current_pulse_.duration0 = this->elapsed(now);
-    } else if (this->current_pulse_.duration0 > 0) {
-        this->current_pulse_.level1 = !level;
-        this->current_pulse_.duration1 = this->elapsed(now);
-        BaseType_t res = xRingbufferSendFromISR(
-            this->rb_, (void*)&this->current_pulse_, sizeof(this->current_pulse_), &HPTaskAwoken);
-        // reset for next pass
-        memset((void*)&this->current_pulse_, 0x00, sizeof(this->current_pulse_));
+    if (xRingbufferSendFromISR(this->rb_, &edge, sizeof(edge), &HPTaskAwoken) != pdTRUE) {
+        this->rx_dropped_edges_ = this->rx_dropped_edges_ + 1;
+    } else if (!level) {
+        // the end of a high level completes a pulse, wake the decoder for it
+        DecodeWorker::notify_from_isr(this->worker_index_, &HPTaskAwoken);
+    }
+    this->last_change_us_ = now;
+
+    uint32_t cycles = arch_get_cpu_cycle_count() - start_cycles;
+    size_t bucket = 0;
+    for (uint32_t rest = cycles >> isr_histogram_first_shift;
+         rest != 0 && bucket < isr_histogram_buckets - 1; rest >>= 1) {
+        bucket++;
     }
+    this->isr_stats_.buckets[bucket] = this->isr_stats_.buckets[bucket] + 1;
+    this->isr_stats_.count = this->isr_stats_.count + 1;
+    if (cycles > this->isr_stats_.max_cycles) this->isr_stats_.max_cycles = cycles;
 
     if (HPTaskAwoken == pdTRUE) {
         portYIELD_FROM_ISR();
     }
-    this->last_change_us_ = now;
 }
 
-bool Bus::has_time_to_send() {
-    bool result = false;
-    static unsigned long last_send_time = 0; // Tracks the last time a message was sent
-
-    unsigned long current_time = millis();
-    uint32_t end_of_transmit = current_time + this->transmit_count * single_frame_max_duration_ms;
+bool Bus::arm_tx_if_ready() {
+    if (this->tx_arm_time_ms_.has_value()) return true;
+    uint32_t now = millis();
+    if (!this->scheduler_.is_tx_ready(now, this->tx_ready_idle_window_ms_)) return false;
+    this->tx_arm_time_ms_ = now - this->tx_start_ms_;
+    ESP_LOGI(TAG_BUS, "Transmit armed after %ums (controller %s)", this->tx_arm_time_ms_.value(),
+        this->scheduler_.has_controller() ? "detected" : "not detected");
+    return true;
+}
 
-    if (this->has_controller() && this->is_controller_timeout()) {
-        return true; // assume controller was disconnected
+uint32_t Bus::time_to_slot(const std::vector<std::shared_ptr<BaseFrame>>& packets) {
+    uint32_t now = millis();
+    uint32_t frames_duration = 0;
+    for (const auto& packet : packets) {
+        frames_duration += this->scheduler_.frame_duration_ms(packet->packet.get_type()) +
+                           controler_frame_spacing_duration_ms;
+    }
+    uint32_t needed = this->adaptive_repeats_
+                          ? this->confirmed_burst_duration(frames_duration)
+                          : this->transmit_count * frames_duration + controler_group_spacing_ms;
+    uint32_t not_before = now;
+    if (this->previous_sent_packet_.has_value()) {
+        not_before = this->previous_sent_packet_.value() + delay_between_sending_messages_ms;
     }
+    if (this->collision_retries_ > 0) {
+        not_before = BusScheduler::time_max(not_before, this->collision_backoff_until_ms_);
+    }
+    uint32_t slot = this->scheduler_.next_slot(now, needed, not_before);
+    int32_t wait = BusScheduler::time_diff(slot, now);
+
+    if (BusScheduler::time_diff(now, this->last_slot_log_ms_) >= 1000) {
+        auto next_controller = this->next_controller_packet();
+        ESP_LOGV(TAG_BUS, "Next slot in %dms (needed: %ums, next controller: %us)",
+            wait > 0 ? wait : 0, needed,
+            next_controller.has_value() ? (next_controller.value() / 1000) : 0);
+        this->last_slot_log_ms_ = now;
+    }
+    return wait > 0 ? static_cast<uint32_t>(wait) : 0;
+}
 
-    if (this->next_controller_packet().has_value()) {
-        auto next = this->next_controller_packet().value();
-        result = (end_of_transmit < next);
-    } else {
-        result = true;
+void Bus::send_frame(const BaseFrame& packet, size_t repeats) {
+    while (repeats > 0) {
+        sendHeader();
+        size_t transmitIndex = 0;
+        while (transmitIndex < packet.size()) {
+            for (int bitIndex = 0; bitIndex <= 7; bitIndex++) {
+                _sendLow(bit_low_duration_ms);
+                if (get_bit(packet[transmitIndex], bitIndex)) {
+                    _sendHigh(bit_long_high_duration_ms);
+                } else {
+                    _sendHigh(bit_low_duration_ms);
+                }
+            }
+            transmitIndex++;
+        }
+
+        if (--repeats > 0) {
+            _sendLow(bit_low_duration_ms);
+            _sendHigh(controler_frame_spacing_duration_ms);
+        }
     }
+}
 
-    // Check if at least 1 second has passed since the last message
-    if (current_time - last_send_time < 1000) {
-        ESP_LOGV(TAG_BUS, "Has time to send: %s. (next: %d, needed: %d)", result ? "true" : "false",
-            this->next_controller_packet().has_value()
-                ? (this->next_controller_packet().value() / 1000)
-                : 0,
-            end_of_transmit / 1000);
-        last_send_time = current_time;
+uint32_t Bus::confirmed_burst_duration(uint32_t frames_duration) const {
+    uint32_t duration = 0;
+    size_t sent = 0;
+    size_t group = this->repeat_group_;
+    while (sent < this->transmit_count) {
+        size_t repeats = std::min(group, this->transmit_count - sent);
+        duration += repeats * frames_duration + this->confirm_window_ms_;
+        sent += repeats;
+        group *= 2;
     }
+    return duration;
+}
 
-    return result;
+void Bus::mark_tx_level(uint32_t target_us) {
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    if (this->tx_level_target_us_ != 0) {
+        uint32_t actual = now - this->tx_level_start_us_;
+        uint32_t error = actual > this->tx_level_target_us_ ? actual - this->tx_level_target_us_
+                                                            : this->tx_level_target_us_ - actual;
+        auto& stats = this->tx_timing_stats_;
+        stats.max_error_us = std::max(stats.max_error_us, error);
+        stats.avg_error_us =
+            stats.samples == 0 ? error : stats.avg_error_us - stats.avg_error_us / 64 + error / 64;
+        if (error > pulse_duration_threshold_us) stats.out_of_tolerance++;
+        stats.samples++;
+    }
+    this->tx_level_start_us_ = now;
+    this->tx_level_target_us_ = target_us;
 }
 
-void Bus::process_send_queue() {
-    std::shared_ptr<BaseFrame> packet;
+void Bus::set_tx_pin_mode() {
+    if (this->collision_detect_) {
+        this->gpio_pin_->pin_mode(gpio::Flags::FLAG_OUTPUT | gpio::Flags::FLAG_INPUT |
+                                  gpio::Flags::FLAG_OPEN_DRAIN | gpio::Flags::FLAG_PULLUP);
+        // the ISR watches the line while we release it, see isr_handler()
+        this->gpio_pin_->attach_interrupt(&Bus::isr_handler, this, gpio::INTERRUPT_ANY_EDGE);
+    } else {
+        this->gpio_pin_->pin_mode(gpio::Flags::FLAG_OUTPUT | gpio::Flags::FLAG_PULLUP);
+    }
+}
 
-    if (!this->tx_packets_queue.has_next()) return;
-    this->tx_packets_queue.logging_enabled = true;
-    if (this->current_frame.is_started()) {
-        ESP_LOGV(TAG_BUS, "Packet being received. waiting");
+void Bus::play_levels() {
+    this->tx_engine_.start();
+    uint32_t delay_us = this->tx_step();
+    if (this->tx_step_timer_ != nullptr) {
+        if (delay_us > 0) esp_timer_start_once(this->tx_step_timer_, delay_us);
         return;
     }
-    if (!this->is_time_for_next()) {
-        ESP_LOGD(TAG_BUS, "Queue has next but need to throttle. Waiting.");
-        return;
+    while (delay_us > 0) {
+        delayMicroseconds(delay_us);
+        delay_us = this->tx_step();
     }
+}
 
-    if (!this->has_time_to_send()) {
-        ESP_LOGW(TAG_BUS, "No time to send before next panel message. Waiting.");
-        return;
+uint32_t Bus::tx_step() {
+    if (this->tx_readback_ && this->tx_level_target_us_ != 0 && !this->tx_driving_low_ &&
+        !this->gpio_pin_->digital_read()) {
+        // the line never went up while we released it, someone else is holding it low
+        this->tx_collision_ = true;
     }
-    ESP_LOGI(TAG_BUS, "Retrieving packet from queue");
-    if (this->tx_packets_queue.try_dequeue(&packet)) {
-        ESP_LOGI(TAG_BUS, "Packet received, type: %s", packet->type_string());
-        this->mode = BUSMODE_TX;
-        ESP_LOGD(TAG_BUS, "Resetting existing packet (if any)");
-        this->current_frame.reset("TX Start");
-        this->reset_pulse_log();
-        packet->print("SEND", TAG_BUS, ESPHOME_LOG_LEVEL_INFO, __LINE__);
-        auto transmitCount = this->transmit_count;
-        this->gpio_pin_->pin_mode(gpio::Flags::FLAG_OUTPUT | gpio::Flags::FLAG_PULLUP);
-        while (transmitCount > 0) {
-            sendHeader();
-            size_t transmitIndex = 0;
-            while (transmitIndex < packet->size()) {
-                for (int bitIndex = 0; bitIndex <= 7; bitIndex++) {
-                    _sendLow(bit_low_duration_ms);
-                    if (get_bit((*packet)[transmitIndex], bitIndex)) {
-                        _sendHigh(bit_long_high_duration_ms);
-                    } else {
-                        _sendHigh(bit_low_duration_ms);
-                    }
+    tx_level_t level;
+    if (this->tx_collision_ || !this->tx_engine_.next_level(level)) {
+        // stop driving the line right away, the bus engine takes it from there
+        this->tx_engine_.abort();
+        return 0;
+    }
+    this->tx_driving_low_ = !level.high;
+    this->tx_readback_ = this->collision_detect_ && this->tx_engine_.is_readback_level();
+    this->mark_tx_level(level.duration_us);
+    this->gpio_pin_->digital_write(level.high);
+    return level.duration_us;
+}
+
+void Bus::tx_step_timer_cb(void* arg) {
+    auto* bus = static_cast<Bus*>(arg);
+    uint32_t delay_us = bus->tx_step();
+    if (delay_us > 0) {
+        esp_timer_start_once(bus->tx_step_timer_, delay_us);
+    } else {
+        DecodeWorker::notify(bus->worker_index_);
+    }
+}
+
+uint32_t Bus::handle_collision(const std::vector<std::shared_ptr<BaseFrame>>& unsent) {
+    this->collision_stats_.collisions++;
+    if (this->collision_retries_ >= this->collision_max_retries_) {
+        ESP_LOGE(TAG_BUS, "Collision on the bus, giving up on %u frame(s) after %u retries",
+            unsent.size(), this->collision_retries_);
+        this->collision_stats_.abandoned += unsent.size();
+        for (const auto& frame : unsent) {
+            this->command_tracker_.on_discarded(*frame, COMMAND_ABANDONED, millis());
+        }
+        this->collision_retries_ = 0;
+        return this->tx_packets_queue.has_next() ? 0 : tx_wait_forever;
+    }
+    this->collision_retries_++;
+    this->collision_stats_.retries++;
+    this->command_tracker_.on_requeued(unsent);
+    this->tx_packets_queue.requeue(unsent, millis());
+    // exponential backoff with random jitter, so two talkers that collided don't retry in sync
+    uint32_t backoff = this->collision_backoff_ms_ << (this->collision_retries_ - 1);
+    backoff += esp_random() % (backoff + 1);
+    this->collision_backoff_until_ms_ = millis() + backoff;
+    ESP_LOGW(TAG_BUS, "Collision on the bus, retry %u/%u in %ums", this->collision_retries_,
+        this->collision_max_retries_, backoff);
+    return backoff;
+}
+
+uint32_t Bus::send_round() {
+    this->tx_engine_.clear();
+    size_t count = this->confirmations_count_;
+    bool sent_any = false;
+    for (size_t i = 0; i < this->tx_batch_.size(); i++) {
+        size_t repeats = this->transmit_count;
+        if (i < count) {
+            tx_confirmation_t& confirmation = this->confirmations_[i];
+            if (confirmation.confirmed || confirmation.repeats >= this->transmit_count) {
+                continue;
+            }
+            repeats = std::min(this->tx_group_, this->transmit_count - confirmation.repeats);
+            confirmation.repeats += repeats;
+        } else if (!this->tx_first_round_) {
+            // frames we cannot track were sent the full count in the first round
+            continue;
+        }
+        if (sent_any) {
+            _sendLow(bit_low_duration_ms);
+            _sendHigh(controler_frame_spacing_duration_ms);
+        }
+        if (this->tx_first_round_) {
+            this->tx_batch_[i]->print("SEND", TAG_BUS, ESPHOME_LOG_LEVEL_INFO, __LINE__);
+        }
+        this->send_frame(*this->tx_batch_[i], repeats);
+        sent_any = true;
+    }
+    if (!sent_any) return this->end_burst({});
+    this->tx_first_round_ = false;
+    // terminate the last bit. In closed-loop mode, the pull-up then holds the line while we
+    // listen for the echo.
+    _sendLow(bit_low_duration_ms);
+    // the heater may answer our last frame during the open-loop group spacing: no collision
+    this->tx_engine_.end_readback();
+    if (!this->adaptive_repeats_) _sendHigh(controler_group_spacing_ms);
+
+    this->mode = BUSMODE_TX;
+    this->set_tx_pin_mode();
+    this->play_levels();
+    // the step timer wakes us up once the levels are sent
+    return this->tx_engine_.get_state() == TX_ENGINE_SENDING ? tx_wait_forever : 0;
+}
+
+uint32_t Bus::on_round_sent() {
+    if (!this->adaptive_repeats_ || this->tx_collision_) {
+        this->start_receive();
+        std::vector<std::shared_ptr<BaseFrame>> unsent;
+        if (this->tx_collision_) {
+            for (size_t i = 0; i < this->tx_batch_.size(); i++) {
+                if (i >= this->confirmations_count_ || !this->confirmations_[i].confirmed) {
+                    unsent.push_back(this->tx_batch_[i]);
                 }
-                transmitIndex++;
             }
+        }
+        return this->end_burst(unsent);
+    }
+    this->current_frame.reset("Confirm window");
+    this->confirm_armed_ = true;
+    start_receive();
+    this->tx_engine_.wait_until(TX_ENGINE_LISTENING, millis() + this->confirm_window_ms_);
+    return this->confirm_window_ms_;
+}
 
-            if (--transmitCount > 0) {
-                _sendLow(bit_low_duration_ms);
-                _sendHigh(controler_frame_spacing_duration_ms);
+uint32_t Bus::on_listening() {
+    uint32_t now = millis();
+    if (this->tx_engine_.get_state() == TX_ENGINE_LISTENING) {
+        uint32_t left = this->tx_engine_.time_left(now);
+        if (!this->is_burst_confirmed() && left > 0) return left;
+        // don't talk over a frame that started during the window
+        this->tx_engine_.wait_until(TX_ENGINE_SETTLING, now + single_frame_max_duration_ms);
+    }
+    if (this->current_frame.is_started() && this->tx_engine_.time_left(now) > 0) {
+        return frame_end_threshold_ms;
+    }
+    this->confirm_armed_ = false;
+    if (this->is_burst_confirmed()) return this->end_burst({});
+    this->tx_group_ *= 2;
+    return this->send_round();
+}
+
+bool Bus::is_burst_confirmed() const {
+    for (size_t i = 0; i < this->confirmations_count_; i++) {
+        if (!this->confirmations_[i].confirmed) return false;
+    }
+    return true;
+}
+
+uint32_t Bus::end_burst(const std::vector<std::shared_ptr<BaseFrame>>& unsent) {
+    if (this->adaptive_repeats_ && !this->tx_collision_) {
+        for (size_t i = 0; i < this->confirmations_count_; i++) {
+            const tx_confirmation_t& confirmation = this->confirmations_[i];
+            this->confirm_stats_.commands++;
+            this->confirm_stats_.repeats += confirmation.repeats;
+            if (confirmation.confirmed) {
+                this->confirm_stats_.confirmed++;
+            } else {
+                this->confirm_stats_.unconfirmed++;
+                ESP_LOGW(TAG_BUS, "No echo from the heater after %u repeats of frame type 0x%02X",
+                    confirmation.repeats, confirmation.packet.get_type());
             }
         }
-        _sendLow(bit_low_duration_ms);
-        _sendHigh(controler_group_spacing_ms);
-        this->previous_sent_packet_ = millis();
-        start_receive();
+        ESP_LOGD(TAG_BUS, "Closed-loop TX: %.2f repeats/command, %u/%u confirmed, latency %ums",
+            this->confirm_stats_.repeats_per_command(), this->confirm_stats_.confirmed,
+            this->confirm_stats_.commands, this->confirm_stats_.last_latency_ms);
+    }
+    this->confirmations_count_ = 0;
+    this->tx_batch_.clear();
+    this->tx_engine_.set_idle();
+    this->scheduler_.on_transmit(this->tx_burst_start_ms_, millis());
+    if (this->tx_collision_) {
+        this->tx_collision_ = false;
+        return this->handle_collision(unsent);
+    }
+    this->collision_retries_ = 0;
+    this->previous_sent_packet_ = millis();
+
+    const auto& stats = this->tx_packets_queue.get_stats();
+    ESP_LOGD(TAG_BUS, "TX queue: %u queued, %u merged, %u dropped, %u expired, %u sent in %u "
+                      "bursts, waited %ums on average",
+        stats.enqueued, stats.merged, stats.dropped, stats.expired, stats.sent, stats.bursts,
+        stats.avg_wait_ms);
+    return this->tx_packets_queue.has_next() ? 0 : tx_wait_forever;
+}
+
+void Bus::check_confirmation(const BaseFrame& frame) {
+    for (size_t i = 0; i < this->confirmations_count_; i++) {
+        tx_confirmation_t& confirmation = this->confirmations_[i];
+        const hp_packetdata_t& sent = confirmation.packet;
+        if (confirmation.confirmed || !CommandTracker::is_echo(sent, frame.packet)) continue;
+        uint32_t latency = millis() - confirmation.sent_ms;
+        this->confirm_stats_.last_latency_ms = latency;
+        this->confirm_stats_.avg_latency_ms =
+            this->confirm_stats_.confirmed == 0
+                ? latency
+                : (this->confirm_stats_.avg_latency_ms * 3 + latency) / 4;
+        confirmation.confirmed = true;
+        ESP_LOGD(TAG_BUS, "Heater confirmed frame type 0x%02X after %u repeats (%ums)",
+            sent.get_type(), confirmation.repeats, latency);
+    }
+}
+
+uint32_t Bus::service_tx() {
+    switch (this->tx_engine_.get_state()) {
+    case TX_ENGINE_SENDING:
+        // the step timer wakes us up once the last level is played
+        return tx_wait_forever;
+    case TX_ENGINE_SENT:
+        return this->on_round_sent();
+    case TX_ENGINE_LISTENING:
+    case TX_ENGINE_SETTLING:
+        return this->on_listening();
+    default:
+        return this->process_send_queue();
+    }
+}
+
+uint32_t Bus::process_send_queue() {
+    if (!this->arm_tx_if_ready()) return tx_ready_poll_ms;
+    if (!this->tx_packets_queue.has_next()) return tx_wait_forever;
+    if (this->current_frame.is_started()) {
+        ESP_LOGV(TAG_BUS, "Packet being received. waiting");
+        // we are serviced again once the frame is finalized; this is just a safety net
+        return single_frame_max_duration_ms;
+    }
+    auto pending = this->tx_packets_queue.pending(millis());
+    if (pending.empty()) return tx_wait_forever; // everything pending was stale
+    uint32_t wait = this->time_to_slot(pending);
+    if (wait > 0) {
+        ESP_LOGD(TAG_BUS, "Queue has %u frame(s), waiting %ums for a free bus slot.",
+            pending.size(), wait);
+        return wait;
+    }
+    // take everything that is pending now, including frames queued while we were planning
+    auto batch = this->tx_packets_queue.take_all(millis());
+    if (batch.empty()) return tx_wait_forever;
+    ESP_LOGI(TAG_BUS, "Sending burst of %u frame(s)", batch.size());
+    ESP_LOGD(TAG_BUS, "Resetting existing packet (if any)");
+    this->current_frame.reset("TX Start");
+    this->reset_pulse_log();
+    this->tx_burst_start_ms_ = millis();
+    this->tx_collision_ = false;
+    this->tx_batch_ = std::move(batch);
+    this->command_tracker_.on_sent(this->tx_batch_, this->tx_burst_start_ms_);
+    this->tx_first_round_ = true;
+    this->confirm_armed_ = false;
+    this->confirmations_count_ = 0;
+    if (this->adaptive_repeats_) {
+        size_t count = std::min(this->tx_batch_.size(), max_confirmed_frames);
+        if (count < this->tx_batch_.size()) {
+            ESP_LOGW(TAG_BUS, "Only the first %u frames of the burst will be confirmed", count);
+        }
+        for (size_t i = 0; i < count; i++) {
+            this->confirmations_[i].packet = this->tx_batch_[i]->packet;
+            this->confirmations_[i].sent_ms = this->tx_burst_start_ms_;
+            this->confirmations_[i].repeats = 0;
+            this->confirmations_[i].confirmed = false;
+        }
+        this->confirmations_count_ = count;
+        this->tx_group_ = this->repeat_group_;
     }
+    return this->send_round();
 }
+bool Bus::recover_failed_copy() {
+    if (!this->current_frame.is_started() || !this->current_frame.is_size_valid()) return false;
+    hp_packetdata_t recovered;
+    if (!this->recovery_.add_candidate(this->current_frame.packet, millis(), recovered) &&
+        !(this->recovery_.is_repair_enabled() &&
+            this->recovery_.repair(this->current_frame.packet,
+                this->current_frame.get_bit_margins(), recovered))) {
+        return false;
+    }
+    this->current_frame.packet = recovered;
+    this->finalize_frame(false);
+    return true;
+}
+
 void IRAM_ATTR Bus::finalize_frame(bool timeout) {
-    auto finalized_frame = this->current_frame.finalize(*this->hp_data_);
+    const hp_packetdata_t received = this->current_frame.packet;
+    auto finalized_frame = this->current_frame.finalize(*this->hp_data_, this->registry_);
     if (finalized_frame) {
+        this->recovery_.on_valid_frame(received);
         ESP_LOGVV(TAG_BUS, "New Frame finalized %s", timeout ? "after timeout" : "");
-        if (finalized_frame->get_source() == SOURCE_CONTROLLER) {
+        bool from_controller = finalized_frame->get_source() == SOURCE_CONTROLLER;
+        if (finalized_frame->get_source() == SOURCE_HEATER) {
+            if (this->confirm_armed_) this->check_confirmation(*finalized_frame);
+            if (this->command_tracker_.is_tracking()) {
+                this->command_tracker_.on_heater_frame(*finalized_frame, millis());
+            }
+        }
+        if (from_controller) {
             this->controler_packets_received_ = true;
             this->previous_controller_packet_time_ = millis();
         }
+        // a frame decoded before the previous one could be dated only gets an approximate time
+        if (this->frame_timing_.pending) this->report_frame_timing();
+        this->frame_timing_ = {from_controller ? BURST_CONTROLLER : BURST_HEATER,
+            finalized_frame->packet.get_type(), this->frame_duration_us_,
+            this->frame_last_edge_clock_us_, true};
         // Reset the current frame for the next sequence
         this->current_frame.reset();
         this->reset_pulse_log();
@@ -295,100 +722,184 @@ void IRAM_ATTR Bus::finalize_frame(bool timeout) {
         this->current_frame.reset("Timeout - ");
     }
 }
+void Bus::replay_frame(const hp_packetdata_t& packet, frame_source_t source) {
+    if (this->hp_data_ == nullptr) return;
+    auto last_heater_frame = this->hp_data_->last_heater_frame;
+    auto last_controller_frame = this->hp_data_->last_controller_frame;
+    BaseFrame frame;
+    frame.packet = packet;
+    frame.set_source(source);
+    this->registry_.replay(frame, *this->hp_data_);
+    this->hp_data_->last_heater_frame = last_heater_frame;
+    this->hp_data_->last_controller_frame = last_controller_frame;
+}
 void Bus::dump_known_packets(const char* caller_tag) {
 
-    // BaseFrame::dump_known_packets(caller_tag);
+    // BaseFrame::dump_known_packets(caller_tag, this->registry_);
 
-    BaseFrame::dump_c_code(caller_tag);
+    BaseFrame::dump_c_code(caller_tag, this->registry_);
 }
 void Bus::sendHeader() {
-    if (this->gpio_pin_ == nullptr) return;
-
     // ESP_LOGV(TAG_BUS, "Sending frame header");
 
     _sendLow(frame_heading_low_duration_ms);
     _sendHigh(frame_heading_high_duration_ms);
 }
 
-void Bus::TxTask(void* arg) {
-    Bus* instance = static_cast<Bus*>(arg);
-    ESP_LOGD(TAG_BUS, "Starting TxTask for bus on GPIO%d", instance->gpio_pin_->get_pin());
-    instance->tx_packets_queue.set_task_handle(xTaskGetCurrentTaskHandle());
-    ESP_LOGD(TAG_BUS, "Waiting for 15s");
-    delay(15000);
-    while (true) {
-        instance->process_send_queue();
-        delay(1500);
+uint32_t Bus::edge_time_ms(uint32_t edge_us) {
+    uint64_t now_us = esp_timer_get_time();
+    uint32_t age_us = static_cast<uint32_t>(now_us) - edge_us;
+    // millis() is the esp_timer time in milliseconds too
+    return static_cast<uint32_t>((now_us - age_us) / 1000);
+}
+
+void Bus::report_frame_timing() {
+    auto& timing = this->frame_timing_;
+    timing.pending = false;
+    // the last edge the ISR saw is the last one decoded, at rx_clock_us_
+    uint32_t end_us = this->last_change_us_ - (this->rx_clock_us_ - timing.end_clock_us);
+    uint32_t end_ms = edge_time_ms(end_us);
+    this->scheduler_.on_frame(
+        timing.origin, timing.type, end_ms - timing.duration_us / 1000, end_ms);
+    // on_frame moved the activity back to the frame end
+    this->scheduler_.on_activity(edge_time_ms(this->last_change_us_));
+}
+
+void Bus::process_edge(rx_edge_t edge) {
+    // same pairing as the RMT peripheral: a low level followed by a high level
+    bool level = (edge & rx_edge_level_bit) == 0; // level after the edge
+    uint16_t duration = edge & rx_edge_max_duration_us;
+    this->rx_clock_us_ += duration;
+    if (this->current_pulse_.duration0 == 0 && level) {
+        this->current_pulse_.level0 = !level;
+        this->current_pulse_.duration0 = duration;
+    } else if (this->current_pulse_.duration0 > 0) {
+        this->current_pulse_.level1 = !level;
+        this->current_pulse_.duration1 = duration;
+        this->process_pulse(&this->current_pulse_);
+        if (this->current_frame.is_complete()) {
+            this->finalize_frame(false);
+        }
+        this->current_pulse_ = {};
+    }
+}
+
+void Bus::frame_end_timer_cb(void* arg) {
+    auto* bus = static_cast<Bus*>(arg);
+    uint32_t idle_us = bus->elapsed(static_cast<uint32_t>(esp_timer_get_time()));
+    if (idle_us < frame_end_threshold_ms * 1000) {
+        esp_timer_start_once(bus->frame_end_timer_, frame_end_threshold_ms * 1000 - idle_us);
+        return;
     }
+    bus->frame_end_armed_ = false;
+    DecodeWorker::notify(bus->worker_index_);
 }
-void Bus::RxTask(void* arg) {
-    Bus* instance = static_cast<Bus*>(arg);
+
+void Bus::service_rx() {
     size_t rx_size = 0;
-    bool received_msg = true; // force display at least once
-    instance->mode = BUSMODE_RX;
-
-    while (true) {
-        rmt_item32_t* items =
-            (rmt_item32_t*)xRingbufferReceive(instance->rb_, &rx_size, 120 * portTICK_PERIOD_MS);
-
-        if (items && rx_size > 0) {
-            size_t count = static_cast<size_t>(rx_size / sizeof(rmt_item32_t));
-            if (instance->mode == BUSMODE_RX) {
-                instance->current_frame.passes_count++;
-
-                // ESP_LOGVV(TAG_BUS, "Received %d bytes from the ring buffer (%d items)", rx_size,
-                // count);
-                for (size_t i = 0; i < count; i++) {
-                    instance->process_pulse(&items[i]);
-                    if (instance->current_frame.is_complete()) {
-                        instance->finalize_frame(false);
-                    }
-                }
-                received_msg = true;
-            } else {
-                ESP_LOGD(TAG_BUS,
-                    "Received %d frames from the ring buffer. Ignoring since mode is not RX",
-                    count);
+    bool received = false;
+    rx_edge_t* edges;
+
+    size_t used = rx_ring_size - xRingbufferGetCurFreeSize(this->rb_);
+    if (used > this->rx_stats_.high_water_bytes) this->rx_stats_.high_water_bytes = used;
+    uint32_t dropped = this->rx_dropped_edges_;
+    if (dropped != this->rx_dropped_seen_) {
+        // a hole in the edges breaks the pulse pairing, resync on the next frame start
+        ESP_LOGV(TAG_BUS, "%u edge(s) dropped, ring buffer full", dropped - this->rx_dropped_seen_);
+        this->rx_dropped_seen_ = dropped;
+        this->current_pulse_ = {};
+        if (this->current_frame.is_started()) {
+            this->rx_stats_.overruns++;
+            this->current_frame.reset("Dropped edges");
+        }
+    }
+
+    if (used > 0) {
+        // the newest edge is in the ring, so this is how late the decoder is on the line
+        uint32_t lag = this->elapsed(static_cast<uint32_t>(esp_timer_get_time()));
+        auto& lag_stats = this->rx_lag_stats_;
+        lag_stats.max_us = std::max(lag_stats.max_us, lag);
+        lag_stats.avg_us =
+            lag_stats.samples == 0 ? lag : lag_stats.avg_us - lag_stats.avg_us / 64 + lag / 64;
+        lag_stats.samples++;
+    }
+    // byte buffers hand out everything contiguous at once, at most two reads per wrap
+    while ((edges = (rx_edge_t*)xRingbufferReceiveUpTo(this->rb_, &rx_size, 0, rx_ring_size)) !=
+           nullptr) {
+        size_t count = rx_size / sizeof(rx_edge_t);
+        this->rx_stats_.edges += count;
+        if (this->mode == BUSMODE_RX) {
+            this->current_frame.passes_count++;
+            for (size_t i = 0; i < count; i++) {
+                this->process_edge(edges[i]);
             }
-            // Return the items to the ring buffer
-            vRingbufferReturnItem(instance->rb_, (void*)items);
+            this->scheduler_.on_activity(edge_time_ms(this->last_change_us_));
+            received = true;
         } else {
-            if (instance->mode == BUSMODE_RX && instance->current_frame.is_started() &&
-                instance->current_pulse_.duration0 > 0 &&
-                instance->elapsed(esp_timer_get_time()) > (frame_end_threshold_ms * 1000)) {
-                rmt_item32_t pulse;
-                memcpy((void*)&pulse, (void*)&instance->current_pulse_,
-                    sizeof(instance->current_pulse_));
-                memset((void*)&instance->current_pulse_, 0, sizeof(instance->current_pulse_));
-                ESP_LOGV(TAG_BUS, "Bus TIMEOUT. %s", instance->format_pulse_item(&pulse).c_str());
-                received_msg = true;
-                instance->process_pulse(&pulse);
-                if (instance->current_frame.is_complete()) {
-                    instance->finalize_frame(true);
-                } else {
-                    ESP_LOGD(TAG_BUS, "%s", instance->current_frame.to_string("Inco").c_str());
-                    instance->current_frame.debug();
-                    instance->current_frame.reset("Timeout - ");
-                    instance->log_pulses();
-                }
-                instance->reset_pulse_log();
-            }
-            if (received_msg) {
-                ESP_LOGVV(TAG_BUS, "No item received from the ring buffer");
-                // only display once
-                received_msg = false;
-            }
+            ESP_LOGD(TAG_BUS,
+                "Received %d edges from the ring buffer. Ignoring since mode is not RX", count);
         }
+        vRingbufferReturnItem(this->rb_, (void*)edges);
+    }
+    if (received) {
+        this->rx_idle_logged_ = false;
+        if ((this->current_frame.is_started() || this->frame_timing_.pending) &&
+            !this->frame_end_armed_ && this->frame_end_timer_ != nullptr) {
+            this->frame_end_armed_ = true;
+            esp_timer_start_once(this->frame_end_timer_, frame_end_threshold_ms * 1000);
+        }
+        return;
     }
 
-    vTaskDelete(NULL);
+    uint32_t idle_us = this->elapsed(static_cast<uint32_t>(esp_timer_get_time()));
+    if (this->mode == BUSMODE_RX && this->current_frame.is_started() &&
+        this->current_pulse_.duration0 > 0 && idle_us >= (frame_end_threshold_ms * 1000)) {
+        auto& stats = this->frame_end_stats_;
+        stats.last_us = idle_us - frame_end_threshold_ms * 1000;
+        stats.max_us = std::max(stats.max_us, stats.last_us);
+        stats.avg_us = stats.count == 0 ? stats.last_us
+                                        : stats.avg_us - stats.avg_us / 16 + stats.last_us / 16;
+        stats.count++;
+        rmt_item32_t pulse = this->current_pulse_;
+        this->current_pulse_ = {};
+        ESP_LOGV(TAG_BUS, "Bus TIMEOUT. %s", this->format_pulse_item(&pulse).c_str());
+        this->rx_idle_logged_ = false;
+        this->process_pulse(&pulse);
+        if (this->current_frame.is_complete()) {
+            this->finalize_frame(true);
+        } else if (!this->recover_failed_copy()) {
+            ESP_LOGD(TAG_BUS, "%s", this->current_frame.to_string("Inco").c_str());
+            this->current_frame.debug();
+            this->current_frame.reset("Timeout - ");
+            this->log_pulses();
+        }
+        this->reset_pulse_log();
+    }
+    // nothing left in the ring and no edge since: last_change_us_ is the last edge decoded
+    if (this->frame_timing_.pending && idle_us >= frame_end_threshold_ms * 1000) {
+        this->report_frame_timing();
+    }
+    if (!this->rx_idle_logged_) {
+        ESP_LOGVV(TAG_BUS, "No item received from the ring buffer");
+        // only display once
+        this->rx_idle_logged_ = true;
+    }
 }
 std::vector<std::shared_ptr<BaseFrame>> Bus::control(const HWPCall& call) {
-    auto& registry = BaseFrame::get_registry();
+    auto& registry = this->registry_;
 
     std::vector<std::shared_ptr<BaseFrame>> result;
     for (size_t i = 0; i < registry.size(); i++) {
-        auto frame = registry[i].instance->control(call);
+        // build on top of the changes still waiting to be sent, if any
+        auto source = this->tx_packets_queue.find_pending(*registry[i].instance);
+        if (!source) source = registry[i].instance;
+        if (source->is_restored()) {
+            // The saved copy may be stale: a command built on it could undo a change made on
+            // the heater since, so this frame type waits until the heater sends it again.
+            ESP_LOGD(TAG_BUS, "Not building a command on the restored %s", source->type_string());
+            continue;
+        }
+        auto frame = source->control(call);
         if (frame.has_value()) {
             frame.value()->print("PUSH", TAG_BUS, ESPHOME_LOG_LEVEL_VERBOSE, __LINE__);
             result.push_back(frame.value());
@@ -398,7 +909,7 @@ std::vector<std::shared_ptr<BaseFrame>> Bus::control(const HWPCall& call) {
 }
 
 void Bus::traits(climate::ClimateTraits& traits, heat_pump_data_t& hp_data) {
-    auto& registry = BaseFrame::get_registry();
+    auto& registry = this->registry_;
     for (size_t i = 0; i < registry.size(); i++) {
         registry[i].instance->traits(traits, hp_data);
     }
@@ -46,18 +46,28 @@
 #include "base_frame.h"
 #include "esphome/components/logger/logger.h"
 #include "esphome/core/optional.h"
+#include <esp_timer.h>
 #include <map>
 #include <sstream>
 
+#include "BusScheduler.h"
+#include "CommandTracker.h"
+#include "DecodeWorker.h"
+#include "FrameRecovery.h"
 #include "Decoder.h"
+#include "TxEngine.h"
 
 #include "SpinLockQueue.h"
+#include "TxQueue.h"
 #include "esphome/core/gpio.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/helpers.h"
 
 // Uncomment the line below to enable debugging the bus pulses
+// Pulse dumps are formatted in the RX path, so they are left out with deferred logging
+#ifndef USE_HWP_DEFERRED_LOGGING
 #define PULSE_DEBUG
+#endif
 
 namespace esphome {
 namespace hwp {
@@ -68,6 +78,141 @@ static constexpr char TAG_BUS[] = "hwp";
 
 extern const uint32_t single_frame_max_duration_ms;
 extern const uint8_t default_frame_transmit_count;
+static constexpr uint32_t tx_wait_forever = UINT32_MAX;
+static constexpr uint32_t default_tx_ready_idle_window_ms = 1000;
+static constexpr uint8_t default_tx_repeat_group = 2;
+// the heater resumes talking about 2s after a controller burst, so its echo comes after that
+static constexpr uint32_t default_tx_confirm_window_ms = 2500;
+static constexpr size_t max_confirmed_frames = 8;
+static constexpr uint8_t default_tx_collision_max_retries = 3;
+static constexpr uint32_t default_tx_collision_backoff_ms = 500;
+static constexpr uint32_t readback_settle_us = 100; ///< Time for the pull-up to raise the line
+static constexpr int8_t task_core_any = -1; ///< Let FreeRTOS pick the core
+static constexpr uint8_t default_task_priority = 1;
+
+/**
+ * @brief Difference between the intended and the actual width of the levels sent.
+ *
+ * Widths are measured between two consecutive writes to the line, so any latency of the step
+ * timer playing the levels shows up as an error.
+ */
+typedef struct {
+    uint32_t samples;          ///< Levels measured
+    uint32_t max_error_us;     ///< Worst absolute error
+    uint32_t avg_error_us;     ///< Running average of the absolute error
+    uint32_t out_of_tolerance; ///< Levels off by more than the decoders accept
+} tx_timing_stats_t;
+
+/**
+ * @brief Delay between the last captured edge and the moment the decoder picks it up.
+ */
+typedef struct {
+    uint32_t samples;
+    uint32_t max_us;
+    uint32_t avg_us; ///< Running average
+} rx_lag_stats_t;
+
+/**
+ * @brief One captured edge, as pushed by the ISR.
+ *
+ * The top bit is the level that just ended and the low 15 bits its duration in microseconds,
+ * saturated. This is the layout of half an rmt_item32_t, so pulses are rebuilt without any
+ * conversion.
+ */
+typedef uint16_t rx_edge_t;
+static constexpr rx_edge_t rx_edge_level_bit = 0x8000;
+static constexpr rx_edge_t rx_edge_max_duration_us = 0x7FFF;
+/// Byte ring shared by the ISR and the decoder, room for about 100 frames of edges.
+static constexpr size_t rx_ring_size = 12 * frame_data_length * (8 + 2) * sizeof(rmt_item32_t);
+
+/**
+ * @brief A decoded frame waiting for the line to go idle before it is dated.
+ *
+ * The edges only carry durations, so the decoder runs its own clock by adding them up. Once
+ * the line is idle, the ISR time of the last edge maps that clock back to esp_timer.
+ */
+typedef struct {
+    burst_origin_t origin;
+    uint8_t type;
+    uint32_t duration_us; ///< From the start of the header to the last bit
+    uint32_t end_clock_us; ///< Decoder clock at the last bit
+    bool pending;
+} rx_frame_timing_t;
+
+/**
+ * @brief Statistics of the edge capture between the ISR and the decoder.
+ */
+typedef struct {
+    uint32_t edges;          ///< Edges read back from the ring buffer
+    uint32_t dropped_edges;  ///< Edges lost because the ring buffer was full
+    uint32_t overruns;       ///< Frames abandoned because edges were dropped while receiving
+    size_t high_water_bytes; ///< Highest ring buffer fill level seen by the decoder
+    uint32_t glitches_merged; ///< Glitch pulses merged with the next one into a valid bit
+    uint32_t erasures;        ///< Glitch pulses kept as an unreadable bit
+} rx_capture_stats_t;
+
+/// Invalid pulses tolerated per frame before it is dropped.
+static constexpr uint8_t max_frame_glitches = 1;
+
+/**
+ * @brief Delay between the moment a frame end could be detected (frame_end_threshold_ms
+ * after its last edge) and the moment it was finalized, in microseconds.
+ */
+typedef struct {
+    uint32_t count;   ///< Frames finalized after the bus went idle
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t avg_us;  ///< Running average over the last 16 frames or so
+} frame_end_stats_t;
+
+/// Bucket i counts the interrupts that took less than 512 << i CPU cycles, the last bucket
+/// everything above.
+static constexpr size_t isr_histogram_buckets = 8;
+static constexpr uint8_t isr_histogram_first_shift = 9;
+
+/**
+ * @brief Execution time of the edge interrupt handler, in CPU cycles.
+ */
+typedef struct {
+    uint32_t count;      ///< Interrupts measured
+    uint32_t max_cycles; ///< Worst case since boot
+    uint32_t buckets[isr_histogram_buckets];
+} isr_timing_stats_t;
+
+/**
+ * @brief Statistics of the collisions detected while transmitting.
+ */
+typedef struct {
+    uint32_t collisions; ///< Bursts aborted because the line was pulled low by someone else
+    uint32_t retries;    ///< Bursts retried after a collision
+    uint32_t abandoned;  ///< Frames given up on after too many collisions
+} tx_collision_stats_t;
+
+/**
+ * @brief Statistics of the closed-loop (confirmed) transmissions.
+ */
+typedef struct {
+    uint32_t commands;        ///< Frames sent in closed-loop mode
+    uint32_t confirmed;       ///< Frames echoed back by the heater
+    uint32_t unconfirmed;     ///< Frames sent the maximum number of times without echo
+    uint32_t repeats;         ///< Total repeats sent for all the commands
+    uint32_t last_latency_ms; ///< Delay between first transmission and echo, last command
+    uint32_t avg_latency_ms;  ///< Running average of the confirmation delay
+
+    float repeats_per_command() const {
+        return this->commands == 0 ? 0.0f : static_cast<float>(this->repeats) / this->commands;
+    }
+} tx_confirm_stats_t;
+
+/**
+ * @brief A frame sent in closed-loop mode, waiting for the heater echo.
+ */
+typedef struct {
+    hp_packetdata_t packet; ///< What was sent, to compare with the echo
+    uint32_t sent_ms;       ///< Time of the first transmission
+    uint8_t repeats;        ///< Number of times the frame was sent so far
+    volatile bool confirmed;
+} tx_confirmation_t;
 
 /**
  * @enum bus_mode_t
@@ -82,6 +227,11 @@ typedef enum { BUSMODE_TX, BUSMODE_RX, BUSMODE_ERROR } bus_mode_t;
  * This class is responsible for managing bus communication by transmitting and
  * receiving data using the bit-banging method. It uses queues to manage incoming
  * and outgoing data and handles synchronization using FreeRTOS.
+ *
+ * Nothing blocks: both directions are serviced by the shared DecodeWorker task. Received
+ * edges are decoded by service_rx(), and service_tx() moves the TxEngine from one state to
+ * the next (slot planning, sending, confirmation window). The levels of a burst are played
+ * by a one-shot timer, each step arming the timer for the next one.
  */
 class Bus {
   public:
@@ -116,9 +266,13 @@ class Bus {
     /**
      * @brief Queues frame data for transmission.
      *
+     * A frame of a type that is already pending replaces the pending one, since commands are
+     * built on top of the pending frame (see control()).
+     *
      * @param frame The frame data to queue.
-     * @return true If the frame was successfully queued.
-     * @return false If the queue is full.
+     * @return true If the frame was queued, possibly replacing a pending frame of its type or
+     * evicting a lower priority one.
+     * @return false If the queue is full of higher priority frames.
      */
     bool queue_frame_data(std::shared_ptr<BaseFrame> frame);
 
@@ -129,12 +283,7 @@ class Bus {
      * @return false If the time since the last controller packet is within the allowed delay or
      * if no controller packet has been received yet.
      */
-    bool is_controller_timeout() {
-        return this->previous_controller_packet_time_.has_value() &&
-               this->previous_controller_packet_time_.value() +
-                       (delay_between_controller_messages_ms * 1.5) <
-                   millis();
-    }
+    bool is_controller_timeout() { return this->scheduler_.is_controller_timeout(millis()); }
 
     /**
      * @brief Checks if a controller is connected.
@@ -168,7 +317,7 @@ class Bus {
     optional<uint32_t> next_controller_packet() {
         if (this->previous_controller_packet_time_.has_value()) {
             return this->previous_controller_packet_time_.value() +
-                   delay_between_controller_messages_ms;
+                   this->scheduler_.get_controller_period_ms();
         }
         if (millis() < delay_between_controller_messages_ms) {
             return delay_between_controller_messages_ms;
@@ -204,9 +353,156 @@ class Bus {
      * @param[in] hp_data The heat pump data model.
      */
     void set_data_model(heat_pump_data_t& hp_data) { this->hp_data_ = &hp_data; }
+    /**
+     * @brief Builds the frames needed to apply a call.
+     *
+     * When a frame of a given type is still waiting to be sent, the call is applied on top of
+     * it rather than on the last state received from the bus, so that back to back changes
+     * accumulate into a single latest-state frame. Frame types only known from the saved
+     * state are left out until the heater sends them again.
+     */
     std::vector<std::shared_ptr<BaseFrame>> control(const HWPCall& call);
+    /**
+     * @brief Opens a ticket following the frames of a command, to be called before queuing them.
+     *
+     * @return The ticket, resolved through the command tracker, or no_command_ticket.
+     */
+    command_ticket_t track_command(const std::vector<std::shared_ptr<BaseFrame>>& frames) {
+        return this->command_tracker_.open(frames, millis());
+    }
+    CommandTracker& get_command_tracker() { return this->command_tracker_; }
+    /**
+     * @brief Sets how long the heater has to echo a command once it was sent.
+     */
+    void set_command_timeout(uint32_t timeout_ms) {
+        this->command_tracker_.set_timeout(timeout_ms);
+    }
+    const tx_queue_stats_t& get_tx_queue_stats() const { return this->tx_packets_queue.get_stats(); }
     void traits(climate::ClimateTraits& traits, heat_pump_data_t& hp_data);
-    static void dump_known_packets(const char* CALLER_TAG);
+    void dump_known_packets(const char* CALLER_TAG);
+    /**
+     * @brief Gets the frames decoded on this bus, one instance per known frame class.
+     */
+    FrameRegistry& get_registry() { return this->registry_; }
+    /**
+     * @brief Drains the pulses received since the last call and decodes them.
+     *
+     * Called by the shared DecodeWorker whenever the ISR signals new pulses, and periodically
+     * so that a frame followed by silence gets finalized.
+     */
+    void service_rx();
+    /**
+     * @brief Moves the transmitter to its next state if it is due.
+     *
+     * Called by the shared DecodeWorker after service_rx(), so frames decoded in the same
+     * wake-up (echoes, end of a frame in progress) are taken into account right away.
+     *
+     * @return The number of milliseconds before the transmitter needs to be serviced again,
+     * or `tx_wait_forever` if it only waits for an event (new frame queued, levels sent).
+     */
+    uint32_t service_tx();
+    /**
+     * @brief Rebuilds pulses from the captured edges and decodes the completed ones.
+     */
+    void process_edge(rx_edge_t edge);
+    /**
+     * @brief Sets how long the bus must be observed idle before transmissions are armed.
+     */
+    void set_tx_ready_idle_window(uint32_t window_ms) { this->tx_ready_idle_window_ms_ = window_ms; }
+    uint32_t get_tx_ready_idle_window() const { return this->tx_ready_idle_window_ms_; }
+    /**
+     * @brief Sets how long a command may wait in the transmit queue before it is discarded.
+     */
+    void set_tx_command_expiry(uint32_t expiry_ms) { this->tx_packets_queue.set_expiry(expiry_ms); }
+    uint32_t get_tx_command_expiry() const { return this->tx_packets_queue.get_expiry(); }
+    size_t get_tx_queue_depth() { return this->tx_packets_queue.size(); }
+    /**
+     * @brief Gets the time it took from startup until transmissions were armed.
+     *
+     * @return The elapsed time in milliseconds, or an empty optional if not armed yet.
+     */
+    optional<uint32_t> get_tx_arm_time_ms() const { return this->tx_arm_time_ms_; }
+    /**
+     * @brief Enables closed-loop transmissions.
+     *
+     * Instead of always sending each frame `transmit_count` times, frames are sent in small
+     * groups of repeats and the bus then listens for the heater to echo the new values back.
+     * Repeating stops as soon as the echo is seen, and each unconfirmed round doubles the
+     * group size up to `transmit_count` repeats in total.
+     *
+     * @param enabled True to enable closed-loop mode.
+     * @param repeat_group Number of repeats sent before the first confirmation window.
+     * @param confirm_window_ms How long to listen for the echo after each group.
+     */
+    void set_adaptive_repeats(bool enabled, uint8_t repeat_group = default_tx_repeat_group,
+        uint32_t confirm_window_ms = default_tx_confirm_window_ms) {
+        this->adaptive_repeats_ = enabled;
+        this->repeat_group_ = repeat_group == 0 ? 1 : repeat_group;
+        this->confirm_window_ms_ = confirm_window_ms;
+    }
+    bool get_adaptive_repeats() const { return this->adaptive_repeats_; }
+    /**
+     * @brief Enables collision detection by reading back the line while transmitting.
+     *
+     * The pin is driven open drain, and the line is sampled while we hold it high. If another
+     * talker pulls it low, the burst is aborted and retried after a randomized backoff that
+     * doubles with each attempt.
+     *
+     * @param enabled True to enable readback.
+     * @param max_retries Number of retries before the frames are abandoned.
+     * @param backoff_ms Base backoff delay before the first retry.
+     */
+    void set_collision_detect(bool enabled, uint8_t max_retries = default_tx_collision_max_retries,
+        uint32_t backoff_ms = default_tx_collision_backoff_ms) {
+        this->collision_detect_ = enabled;
+        this->collision_max_retries_ = max_retries;
+        this->collision_backoff_ms_ = backoff_ms;
+    }
+    bool get_collision_detect() const { return this->collision_detect_; }
+    const tx_collision_stats_t& get_tx_collision_stats() const { return this->collision_stats_; }
+    isr_timing_stats_t get_isr_timing_stats() const {
+        isr_timing_stats_t stats;
+        stats.count = this->isr_stats_.count;
+        stats.max_cycles = this->isr_stats_.max_cycles;
+        for (size_t i = 0; i < isr_histogram_buckets; i++) {
+            stats.buckets[i] = this->isr_stats_.buckets[i];
+        }
+        return stats;
+    }
+    const frame_end_stats_t& get_frame_end_stats() const { return this->frame_end_stats_; }
+    /**
+     * @brief Enables the repair of damaged copies by flipping their least confident bits.
+     */
+    void set_frame_repair(bool enabled) { this->recovery_.set_repair_enabled(enabled); }
+    bool get_frame_repair() const { return this->recovery_.is_repair_enabled(); }
+    const frame_recovery_stats_t& get_frame_recovery_stats() const {
+        return this->recovery_.get_stats();
+    }
+    rx_capture_stats_t get_rx_capture_stats() const {
+        rx_capture_stats_t stats = this->rx_stats_;
+        stats.dropped_edges = this->rx_dropped_edges_;
+        return stats;
+    }
+    const tx_confirm_stats_t& get_tx_confirm_stats() const { return this->confirm_stats_; }
+    bool is_tx_armed() const { return this->tx_arm_time_ms_.has_value(); }
+    /**
+     * @brief Gets the scheduler holding the learned bus timeline.
+     */
+    const BusScheduler& get_scheduler() const { return this->scheduler_; }
+    void restore_timing(burst_origin_t origin, const burst_timing_t& timing) {
+        this->scheduler_.restore_timing(origin, timing);
+    }
+    /**
+     * @brief Runs a frame saved before a reboot through the decoding path.
+     *
+     * The frame updates the registry and the data model as if it had just been received, but
+     * does not count as bus traffic: the heater and controller last seen times are left as is.
+     * Must be called before setup() starts the reception.
+     */
+    void replay_frame(const hp_packetdata_t& packet, frame_source_t source);
+    const tx_timing_stats_t& get_tx_timing_stats() const { return this->tx_timing_stats_; }
+    const rx_lag_stats_t& get_rx_lag_stats() const { return this->rx_lag_stats_; }
+    tx_engine_state_t get_tx_state() const { return this->tx_engine_.get_state(); }
 
   protected:
     
@@ -216,75 +512,210 @@ class Bus {
     optional<uint32_t> previous_sent_packet_;
     volatile bus_mode_t mode;            ///< The current mode of the bus (transmit or receive).
     InternalGPIOPin* gpio_pin_{nullptr}; ///< The GPIO pin used for bus communication.
-    TaskHandle_t TxTaskHandle;           ///< Handle to the I/O task.
-    TaskHandle_t RxTaskHandle;           ///< Handle to the I/O task.
     Decoder current_frame;               ///< The current frame being processed.
     size_t transmit_count;               ///< The number of times to repeat transmission.
     // uint8_t maxBufferCount;              ///< Maximum buffer count for the received frames.
     size_t maxWriteLength; ///< Maximum write length for the transmitted frames.
     SpinLockQueue<std::shared_ptr<BaseFrame>> received_frames; ///< Queue for received frames.
-    SpinLockQueue<std::shared_ptr<BaseFrame>>
-        tx_packets_queue; ///< Queue for frames to be transmitted.
+    TxQueue tx_packets_queue; ///< Queue for frames to be transmitted, one per frame type.
+    CommandTracker command_tracker_; ///< Follows the queued commands until the heater echoes them
     rmt_config_t rmt_tx_config_;
     rmt_config_t rmt_rx_config_;
-    RingbufHandle_t rb_;
+    RingbufHandle_t rb_{nullptr};  ///< Byte ring of rx_edge_t, filled by the ISR
+    volatile uint32_t rx_dropped_edges_{0}; ///< Edges the ISR could not queue
+    uint32_t rx_dropped_seen_{0};  ///< Value of rx_dropped_edges_ already handled by the decoder
+    rx_capture_stats_t rx_stats_{};
+    esp_timer_handle_t frame_end_timer_{nullptr}; ///< Fires once the bus has been idle long enough
+    volatile bool frame_end_armed_{false};
+    frame_end_stats_t frame_end_stats_{};
+    FrameRecovery recovery_;  ///< Damaged copies of the current burst
+    rmt_item32_t glitch_pulse_{};  ///< Invalid pulse waiting for the next one
+    bool glitch_pending_{false};
+    uint8_t frame_glitches_{0};    ///< Invalid pulses tolerated in the current frame
+    FrameRegistry registry_;   ///< State of the frames decoded on this bus.
+    uint8_t worker_index_{0};  ///< Bit used to notify the decode worker from the ISR.
+    bool rx_idle_logged_{false}; ///< Throttles the "nothing received" log.
 #ifdef PULSE_DEBUG
     std::vector<std::string> pulse_strings_; // Vector to store formatted pulse strings
 #endif
-    uint64_t last_change_us_;
-    volatile rmt_item32_t current_pulse_;
-
-    inline uint64_t elapsed(uint64_t now) {
-        if (now >= this->last_change_us_) {
-            return now - this->last_change_us_;
-        } else {
-            return UINT64_MAX - this->last_change_us_ + now + 1;
-        }
-    }
+    // State touched by the ISR. The Bus lives in internal RAM (DRAM), never in PSRAM or flash.
+    ISRInternalGPIOPin isr_pin_;         ///< IRAM-safe register read of the line
+    volatile uint32_t last_change_us_{0}; ///< Time of the last edge, low 32 bits of esp_timer
+    volatile isr_timing_stats_t isr_stats_{};
+    rmt_item32_t current_pulse_{};   ///< Pulse being rebuilt from the captured edges.
+    uint32_t rx_clock_us_{0};         ///< Sum of the decoded level durations
+    BusScheduler scheduler_;          ///< Learned bus timeline, used to plan transmissions.
+    uint32_t frame_duration_us_{0};   ///< Accumulated duration of the frame being received.
+    uint32_t frame_last_edge_clock_us_{0}; ///< Decoder clock at the last bit of the frame.
+    rx_frame_timing_t frame_timing_{};
+    uint32_t last_slot_log_ms_{0};    ///< Throttles the slot planning logs.
+    uint32_t tx_ready_idle_window_ms_{default_tx_ready_idle_window_ms};
+    uint32_t tx_start_ms_{0};         ///< Time at which the bus started waiting for readiness.
+    optional<uint32_t> tx_arm_time_ms_; ///< Time it took to arm transmissions, once armed.
+    bool adaptive_repeats_{false};
+    uint8_t repeat_group_{default_tx_repeat_group};
+    uint32_t confirm_window_ms_{default_tx_confirm_window_ms};
+    tx_confirmation_t confirmations_[max_confirmed_frames]{};
+    volatile size_t confirmations_count_{0};
+    volatile bool confirm_armed_{false}; ///< True while the RX side should look for echoes
+    tx_confirm_stats_t confirm_stats_{};
+    bool collision_detect_{false};
+    uint8_t collision_max_retries_{default_tx_collision_max_retries};
+    uint32_t collision_backoff_ms_{default_tx_collision_backoff_ms};
+    uint8_t collision_retries_{0};     ///< Consecutive collisions for the current burst
+    uint32_t collision_backoff_until_ms_{0};
+    volatile bool tx_collision_{false}; ///< Set when readback saw someone else on the line
+    tx_collision_stats_t collision_stats_{};
+    TxEngine tx_engine_;          ///< Levels and state of the burst being sent
+    esp_timer_handle_t tx_step_timer_{nullptr}; ///< Plays the levels, one per expiry
+    std::vector<std::shared_ptr<BaseFrame>> tx_batch_; ///< Frames of the burst being sent
+    size_t tx_group_{0};          ///< Closed-loop repeats per frame in the current round
+    bool tx_first_round_{false};
+    uint32_t tx_burst_start_ms_{0};
+    volatile bool tx_driving_low_{false}; ///< Lets the ISR tell our lows from someone else's
+    volatile bool tx_readback_{false}; ///< The released line is watched for collisions
+    volatile uint32_t tx_level_start_us_{0}; ///< Time the current level was written to the line
+    uint32_t tx_level_target_us_{0}; ///< Intended width of the current level, 0 when idle
+    tx_timing_stats_t tx_timing_stats_{};
+    rx_lag_stats_t rx_lag_stats_{};
+
+    /// @brief Time since the last edge. 32-bit reads are atomic, and unsigned arithmetic
+    /// handles the wrap every 71 minutes.
+    inline uint32_t elapsed(uint32_t now) const { return now - this->last_change_us_; }
+    /// @brief Converts an edge time, low 32 bits of esp_timer, to the millis() timeline.
+    static uint32_t edge_time_ms(uint32_t edge_us);
+    /// @brief Hands the pending frame timing to the scheduler, dated from the last ISR edge.
+    void report_frame_timing();
 
   private:
     void start_receive();
     /**
      * @brief Processes the send queue.
      *
-     * This function processes the send queue by dequeuing packets and transmitting them
-     * using the bit-banging technique. It handles sending headers, individual bits, and
-     * spacing between frames and groups. It also manages the transmission count.
+     * Once a slot is free, takes every pending frame and starts sending them as one burst.
+     *
+     * @return The number of milliseconds to wait before the queue should be processed again,
+     * or `tx_wait_forever` if there is nothing left to send or a burst was started.
      */
-    void process_send_queue();
+    uint32_t process_send_queue();
     static void isr_handler(Bus* instance);
+    /**
+     * @brief Frame end timer callback, runs in the esp_timer task.
+     *
+     * Edges keep coming while a frame is received, so instead of restarting the timer on each
+     * of them, the callback checks how long the line has really been idle and sleeps again for
+     * the remaining time. The decoder is woken up exactly frame_end_threshold_ms after the
+     * last edge.
+     */
+    static void frame_end_timer_cb(void* arg);
+    /**
+     * @brief Step timer callback, runs in the esp_timer task.
+     *
+     * Drives the next level and arms the timer for its duration. Once the last level was
+     * played, the bus engine is woken up to handle the end of the round.
+     */
+    static void tx_step_timer_cb(void* arg);
+    /**
+     * @brief Drives the next level of the round being sent.
+     *
+     * @return The delay before the next step in microseconds, 0 when the round is over.
+     */
+    uint32_t tx_step();
+    /**
+     * @brief Starts playing the levels of the engine, from the step timer if there is one.
+     */
+    void play_levels();
 
     void isr_handler();
+
     /**
-     * @brief Task function for I/O operations.
+     * @brief Computes when the given packet can be sent without colliding with other talkers.
      *
-     * This function represents the main task for handling I/O operations. It sets task signaling
-     * handles for the pulse and transmit packet queues, waits for notifications or pulses,
-     * processes send queues, and handles received pulses. It also checks for frame end signals
-     * and finalizes received frames.
+     * The required bus time is estimated from the learned duration of the frame type, repeated
+     * `transmit_count` times, and handed to the scheduler along with the throttling delay
+     * between two commands.
      *
-     * @param arg A pointer to the Bus instance.
+     * @param packets The packets that are about to be sent in one burst.
+     * @return The number of milliseconds to wait before the slot opens, 0 to send now.
      */
-    static void TxTask(void* arg);
-    static void RxTask(void* arg);
+    uint32_t time_to_slot(const std::vector<std::shared_ptr<BaseFrame>>& packets);
 
     /**
-     * @brief Checks if there is enough time to send all packets before the next controller packet.
+     * @brief Appends the levels of a frame, repeated with the controller frame spacing in
+     * between.
      *
-     * This function determines if there is sufficient time to transmit all packets before
-     * the arrival of the next controller packet. It checks the estimated end of transmission
-     * time against the next controller packet time or if the controller message delay has passed.
+     * @param packet The frame to send.
+     * @param repeats The number of times the frame is sent.
+     */
+    void send_frame(const BaseFrame& packet, size_t repeats);
+
+    /**
+     * @brief Builds the levels of the next round of the burst and starts playing them.
+     *
+     * In closed-loop mode, each round sends the frames not confirmed yet `tx_group_` times
+     * (see set_adaptive_repeats()). Otherwise the single round sends every frame
+     * `transmit_count` times.
      *
-     * @return true If there is enough time to send all packets.
-     * @return false Otherwise.
+     * @return The number of milliseconds before the transmitter needs to be serviced again.
+     */
+    uint32_t send_round();
+
+    /**
+     * @brief Handles the end of a round: collision, confirmation window or end of the burst.
+     */
+    uint32_t on_round_sent();
+
+    /**
+     * @brief Checks the confirmation window and the frame received during it.
      */
-    bool has_time_to_send();
+    uint32_t on_listening();
 
     /**
-     * @brief Sends the start of frame header on the bus.
+     * @brief Closes the burst: statistics, scheduler and collision retries.
      *
-     * This function sends the start of frame header by setting the bus low for the frame heading
-     * low duration followed by a high duration.
+     * @param unsent The frames to send again after a collision, empty otherwise.
+     */
+    uint32_t end_burst(const std::vector<std::shared_ptr<BaseFrame>>& unsent);
+
+    bool is_burst_confirmed() const;
+
+    /**
+     * @brief Puts the pin in output mode, open drain with input enabled when reading back.
+     */
+    void set_tx_pin_mode();
+
+    /**
+     * @brief Re-queues the frames of an aborted burst and computes the backoff delay.
+     *
+     * @param unsent The frames to send again.
+     * @return The number of milliseconds to wait before the queue is processed again.
+     */
+    uint32_t handle_collision(const std::vector<std::shared_ptr<BaseFrame>>& unsent);
+
+    /**
+     * @brief Computes the worst case bus time of a closed-loop burst, listening included.
+     */
+    uint32_t confirmed_burst_duration(uint32_t frames_duration) const;
+
+    /**
+     * @brief Matches a frame received from the heater against the frames awaiting an echo.
+     *
+     * Called from the RX side, the engine sees the confirmation right after.
+     */
+    void check_confirmation(const BaseFrame& frame);
+
+    /**
+     * @brief Arms transmissions once the scheduler reports the bus timeline as known.
+     *
+     * @return true If transmissions are armed.
+     */
+    bool arm_tx_if_ready();
+
+    /**
+     * @brief Appends the start of frame header to the levels to send.
+     *
+     * The header is the bus held low for the frame heading low duration followed by a high
+     * duration.
      */
     void sendHeader();
 
@@ -307,29 +738,45 @@ class Bus {
     void sendGroupSpacing();
 
     /**
-     * @brief Sends a high signal for a specified duration.
+     * @brief Measures the width of the level being replaced, then starts timing a new one.
+     *
+     * @param target_us Intended width of the new level.
+     */
+    void mark_tx_level(uint32_t target_us);
+
+    /**
+     * @brief Appends a high level to the levels to send.
      *
      * @param ms The duration in milliseconds.
      */
-    void _sendHigh(uint32_t ms) {
-        if (this->gpio_pin_ == nullptr) return;
-        this->gpio_pin_->digital_write(true);
-        delayMicroseconds(ms * 1000);
-    }
+    void _sendHigh(uint32_t ms) { this->tx_engine_.append_level(true, ms); }
 
     /**
-     * @brief Sends a low signal for a specified duration.
+     * @brief Appends a low level to the levels to send.
      *
      * @param ms The duration in milliseconds.
      */
-    void _sendLow(uint32_t ms) {
-        if (this->gpio_pin_ == nullptr) return;
-        this->gpio_pin_->digital_write(false);
-        delayMicroseconds(ms * 1000);
-    }
+    void _sendLow(uint32_t ms) { this->tx_engine_.append_level(false, ms); }
 
     void process_pulse(rmt_item32_t* item);
     void finalize_frame(bool timeout);
+    /**
+     * @brief Hands the current frame, which has a valid size but failed the checksum, to the
+     * burst recovery, and finalizes the recovered frame if any.
+     *
+     * @return true If a frame was recovered (the current frame is reset).
+     */
+    bool recover_failed_copy();
+    /**
+     * @brief Resolves the invalid pulse held in glitch_pulse_ with the pulse that follows.
+     *
+     * If both pulses merge into a valid bit, that bit is appended. Otherwise the glitch is
+     * appended as an erasure (a bit with no timing margin), and the new pulse must be decoded
+     * normally.
+     *
+     * @return true If `item` was consumed by the merge.
+     */
+    bool resolve_glitch(rmt_item32_t* item);
 
     std::string format_pulse_item(const rmt_item32_t* item) {
         if (item == nullptr) {
@@ -0,0 +1,202 @@
+/**
+ * @file BusScheduler.cpp
+ * @brief Implementation of the bus timeline learning and transmit slot planning.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "BusScheduler.h"
+
+namespace esphome {
+namespace hwp {
+
+BusScheduler::BusScheduler(uint32_t controller_period_ms, uint32_t default_frame_duration_ms)
+    : controller_period_ms_(controller_period_ms),
+      default_frame_duration_ms_(default_frame_duration_ms) {}
+
+void BusScheduler::on_frame(
+    burst_origin_t origin, uint8_t type, uint32_t start_ms, uint32_t end_ms) {
+    if (time_diff(end_ms, start_ms) > 0) {
+        this->learn_duration(type, end_ms - start_ms);
+    }
+    this->record_burst(origin, start_ms, end_ms);
+    this->add_usage(origin, start_ms, end_ms);
+    this->on_activity(end_ms);
+}
+
+void BusScheduler::on_transmit(uint32_t start_ms, uint32_t end_ms) {
+    this->record_burst(BURST_LOCAL, start_ms, end_ms);
+    this->add_usage(BURST_LOCAL, start_ms, end_ms);
+    this->on_activity(end_ms);
+}
+
+void BusScheduler::add_usage(burst_origin_t origin, uint32_t start_ms, uint32_t end_ms) {
+    if (!this->has_usage_) {
+        this->usage_.since_ms = start_ms;
+        this->has_usage_ = true;
+    }
+    if (time_diff(end_ms, start_ms) > 0) {
+        this->usage_.busy_ms[origin] += end_ms - start_ms;
+    }
+    uint32_t length = end_ms - this->usage_.since_ms;
+    if (time_diff(end_ms, this->usage_.since_ms) >= static_cast<int32_t>(usage_window_ms)) {
+        for (auto& busy : this->usage_.busy_ms) {
+            busy /= 2;
+        }
+        this->usage_.since_ms = end_ms - length / 2;
+    }
+}
+
+float BusScheduler::get_utilization(burst_origin_t origin, uint32_t now_ms) const {
+    int32_t length = time_diff(now_ms, this->usage_.since_ms);
+    if (!this->has_usage_ || length <= 0) return 0.0f;
+    return 100.0f * this->usage_.busy_ms[origin] / length;
+}
+
+float BusScheduler::get_utilization(uint32_t now_ms) const {
+    float total = 0.0f;
+    for (size_t i = 0; i < BURST_ORIGIN_COUNT; i++) {
+        total += this->get_utilization(static_cast<burst_origin_t>(i), now_ms);
+    }
+    return total;
+}
+
+void BusScheduler::record_burst(burst_origin_t origin, uint32_t start_ms, uint32_t end_ms) {
+    bus_burst_t& burst = this->bursts_[origin];
+    burst_timing_t& timing = this->timings_[origin];
+    if (burst.valid && time_diff(start_ms, burst.end_ms) < static_cast<int32_t>(burst_gap_ms)) {
+        // continuation of the current burst
+        burst.end_ms = end_ms;
+        burst.frames++;
+        return;
+    }
+    if (burst.valid) {
+        // the previous burst is complete; fold it in the estimates before starting a new one
+        uint32_t previous_duration = burst.end_ms - burst.start_ms;
+        timing.duration_ms = smooth(timing.duration_ms, previous_duration);
+        uint32_t period = start_ms - burst.start_ms;
+        bool in_cadence =
+            period > this->controller_period_ms_ / 2 && period < this->controller_period_ms_ * 2;
+        if (origin != BURST_CONTROLLER || in_cadence) {
+            // Out of cadence controller bursts happen when settings are changed on the panel;
+            // they should not drag the learned cadence away from the nominal one.
+            timing.period_ms = smooth(timing.period_ms, period);
+        }
+    }
+    burst.start_ms = start_ms;
+    burst.end_ms = end_ms;
+    burst.frames = 1;
+    burst.valid = true;
+}
+
+void BusScheduler::learn_duration(uint8_t type, uint32_t duration_ms) {
+    for (size_t i = 0; i < this->durations_count_; i++) {
+        if (this->durations_[i].type == type) {
+            this->durations_[i].duration_ms = smooth(this->durations_[i].duration_ms, duration_ms);
+            return;
+        }
+    }
+    if (this->durations_count_ < max_tracked_types) {
+        this->durations_[this->durations_count_++] = {type, static_cast<uint16_t>(duration_ms)};
+    }
+}
+
+uint32_t BusScheduler::frame_duration_ms(uint8_t type) const {
+    for (size_t i = 0; i < this->durations_count_; i++) {
+        if (this->durations_[i].type == type) return this->durations_[i].duration_ms;
+    }
+    return this->default_frame_duration_ms_;
+}
+
+uint32_t BusScheduler::get_controller_period_ms() const {
+    uint32_t learned = this->timings_[BURST_CONTROLLER].period_ms;
+    return learned == 0 ? this->controller_period_ms_ : learned;
+}
+
+bool BusScheduler::is_controller_timeout(uint32_t now_ms) const {
+    const bus_burst_t& burst = this->bursts_[BURST_CONTROLLER];
+    if (!burst.valid) return false;
+    uint32_t period = this->get_controller_period_ms();
+    return time_diff(now_ms, burst.start_ms) > static_cast<int32_t>(period + period / 2);
+}
+
+bool BusScheduler::is_tx_ready(uint32_t now_ms, uint32_t idle_window_ms) const {
+    if (!this->bursts_[BURST_HEATER].valid) return false;
+    if (this->has_activity_ &&
+        time_diff(now_ms, this->last_activity_ms_) < static_cast<int32_t>(idle_window_ms)) {
+        return false;
+    }
+    if (this->bursts_[BURST_CONTROLLER].valid) return true;
+    // no controller so far: wait for a full period to be sure there is none
+    return time_diff(now_ms, this->controller_period_ms_) >= 0;
+}
+
+uint32_t BusScheduler::next_slot(uint32_t now_ms, uint32_t needed_ms, uint32_t not_before) const {
+    uint32_t slot = time_max(now_ms, not_before);
+
+    // Never start while something is on the wire, or right after it.
+    if (this->has_activity_) {
+        slot = time_max(slot, this->last_activity_ms_ + idle_guard_ms);
+    }
+    // A talker whose last frame is recent may still be in the middle of its burst.
+    for (int origin = BURST_HEATER; origin < BURST_LOCAL; origin++) {
+        const bus_burst_t& burst = this->bursts_[origin];
+        if (!burst.valid) continue;
+        if (time_diff(slot, burst.end_ms) < static_cast<int32_t>(burst_gap_ms)) {
+            slot = time_max(slot, burst.end_ms + burst_gap_ms);
+        }
+    }
+
+    // Keep clear of the next controller burst.
+    const bus_burst_t& controller = this->bursts_[BURST_CONTROLLER];
+    uint32_t period = this->get_controller_period_ms();
+    uint32_t controller_duration = this->timings_[BURST_CONTROLLER].duration_ms;
+    uint32_t next_controller;
+    if (controller.valid) {
+        if (this->is_controller_timeout(slot)) return slot;
+        next_controller = controller.start_ms + period;
+        if (time_diff(next_controller, slot) <= 0) {
+            // The controller is late: it is about to talk, or it is gone. Wait for either.
+            return time_max(slot, controller.start_ms + period + period / 2);
+        }
+    } else {
+        // Until a controller was seen, assume one may show up within its first period after boot.
+        if (time_diff(now_ms, period) >= 0) return slot;
+        next_controller = period;
+    }
+    if (time_diff(slot + needed_ms + idle_guard_ms, next_controller) > 0) {
+        slot = next_controller + controller_duration + burst_gap_ms;
+    }
+    return slot;
+}
+
+} // namespace hwp
+} // namespace esphome
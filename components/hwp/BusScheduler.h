@@ -0,0 +1,224 @@
+/**
+ * @file BusScheduler.h
+ * @brief Learns the bus timeline and plans transmit slots around the controller and heater bursts.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @enum burst_origin_t
+ * @brief Identifies who was talking on the bus during a burst.
+ */
+typedef enum { BURST_HEATER, BURST_CONTROLLER, BURST_LOCAL, BURST_ORIGIN_COUNT } burst_origin_t;
+
+/**
+ * @brief A group of frames sent back to back by the same talker.
+ */
+typedef struct {
+    uint32_t start_ms; ///< Start of the first frame of the burst
+    uint32_t end_ms;   ///< End of the last frame seen so far
+    uint16_t frames;   ///< Number of frames seen in the burst
+    bool valid;        ///< True once at least one burst was observed
+} bus_burst_t;
+
+/**
+ * @brief Learned timing of the bursts of a given talker.
+ *
+ * Values are 0 until enough bursts were observed to estimate them.
+ */
+typedef struct {
+    uint32_t period_ms;   ///< Start to start interval between two bursts
+    uint32_t duration_ms; ///< Duration of a burst, from first frame start to last frame end
+} burst_timing_t;
+
+/**
+ * @brief Bus time held by each talker over a decaying window.
+ */
+typedef struct {
+    uint32_t since_ms;                    ///< Start of the window
+    uint32_t busy_ms[BURST_ORIGIN_COUNT]; ///< Time each talker held the bus in the window
+} bus_usage_t;
+
+/**
+ * @class BusScheduler
+ * @brief Learns when the controller and the heater talk and computes the next idle window.
+ *
+ * Every decoded frame is reported with its start and end time. Frames from the same talker
+ * that are closer than `burst_gap_ms` are grouped into a burst, and the scheduler keeps a
+ * running estimate of the burst duration and cadence for each talker, as well as the
+ * duration of each frame type seen on the bus.
+ *
+ * The controller is the only talker that does not back off, so its 60s cadence is treated as
+ * a hard constraint: a transmission is only planned if it ends before the next expected
+ * controller burst, otherwise it is pushed right after it. The heater stops talking when the
+ * controller (or we) take the bus, so we only avoid starting in the middle of one of its bursts.
+ *
+ * The class has no dependency on the hardware or on the logger; all times are passed in
+ * milliseconds and differences are computed so that the 32 bits millis() wrap is harmless.
+ */
+class BusScheduler {
+  public:
+    static constexpr uint32_t burst_gap_ms = 500;  ///< Max spacing between frames of one burst
+    static constexpr uint32_t idle_guard_ms = 200; ///< Margin kept around other talkers' traffic
+    static constexpr size_t max_tracked_types = 16; ///< Frame types with a learned duration
+    /// Once the usage window gets this long, its counters and length are halved, so older
+    /// traffic fades out instead of being forgotten all at once.
+    static constexpr uint32_t usage_window_ms = 60 * 60 * 1000;
+
+    /**
+     * @brief Constructs a new BusScheduler.
+     *
+     * @param controller_period_ms Nominal delay between two controller bursts.
+     * @param default_frame_duration_ms Duration assumed for a frame type never seen before.
+     */
+    BusScheduler(uint32_t controller_period_ms, uint32_t default_frame_duration_ms);
+
+    /**
+     * @brief Records a frame decoded from the bus.
+     *
+     * @param origin Who sent the frame.
+     * @param type The frame type byte.
+     * @param start_ms Time at which the frame header started.
+     * @param end_ms Time of the last edge of the frame.
+     */
+    void on_frame(burst_origin_t origin, uint8_t type, uint32_t start_ms, uint32_t end_ms);
+
+    /**
+     * @brief Records a transmission of ours, so it is accounted for as bus activity.
+     */
+    void on_transmit(uint32_t start_ms, uint32_t end_ms);
+
+    /**
+     * @brief Records raw bus activity (edges) that may not end up as a valid frame.
+     */
+    void on_activity(uint32_t now_ms) {
+        this->last_activity_ms_ = now_ms;
+        this->has_activity_ = true;
+    }
+
+    /**
+     * @brief Returns the learned duration of a frame type, or the default if never seen.
+     */
+    uint32_t frame_duration_ms(uint8_t type) const;
+
+    /**
+     * @brief Computes the earliest time at which `needed_ms` of bus time is guaranteed idle.
+     *
+     * @param now_ms The current time.
+     * @param needed_ms How long the transmission will hold the bus.
+     * @param not_before Earliest acceptable start time (e.g. throttling between commands).
+     * @return The start time of the slot. A value at or before `now_ms` means "send now".
+     */
+    uint32_t next_slot(uint32_t now_ms, uint32_t needed_ms, uint32_t not_before) const;
+
+    /**
+     * @brief True when a controller was seen but missed its expected burst by a wide margin.
+     */
+    bool is_controller_timeout(uint32_t now_ms) const;
+
+    /**
+     * @brief Checks whether enough of the bus timeline is known to start transmitting.
+     *
+     * The bus is considered ready once it was observed idle for `idle_window_ms`, at least one
+     * heater frame was decoded, and the controller cadence is either known (one of its bursts
+     * was seen) or the controller was silent for a whole period since boot.
+     *
+     * @param now_ms The current time.
+     * @param idle_window_ms How long the bus must have been quiet.
+     */
+    bool is_tx_ready(uint32_t now_ms, uint32_t idle_window_ms) const;
+
+    /**
+     * @brief True when a controller burst was seen at least once.
+     */
+    bool has_controller() const { return this->bursts_[BURST_CONTROLLER].valid; }
+
+    const bus_burst_t& last_burst(burst_origin_t origin) const { return this->bursts_[origin]; }
+    const burst_timing_t& timing(burst_origin_t origin) const { return this->timings_[origin]; }
+    /**
+     * @brief Seeds the learned timing of a talker, e.g. with values saved before a reboot.
+     */
+    void restore_timing(burst_origin_t origin, const burst_timing_t& timing) {
+        this->timings_[origin] = timing;
+    }
+    uint32_t get_controller_period_ms() const;
+
+    const bus_usage_t& get_usage() const { return this->usage_; }
+    /**
+     * @brief Gets the share of the usage window during which the bus was held, in percent.
+     */
+    float get_utilization(uint32_t now_ms) const;
+    /**
+     * @brief Gets the share of the usage window during which a talker held the bus, in percent.
+     */
+    float get_utilization(burst_origin_t origin, uint32_t now_ms) const;
+
+    /**
+     * @brief Signed difference between two millis() values, wrap safe.
+     */
+    static int32_t time_diff(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b); }
+    static uint32_t time_max(uint32_t a, uint32_t b) { return time_diff(a, b) >= 0 ? a : b; }
+
+  protected:
+    typedef struct {
+        uint8_t type;
+        uint16_t duration_ms;
+    } type_duration_t;
+
+    uint32_t controller_period_ms_;
+    uint32_t default_frame_duration_ms_;
+    bus_burst_t bursts_[BURST_ORIGIN_COUNT]{};
+    burst_timing_t timings_[BURST_ORIGIN_COUNT]{};
+    type_duration_t durations_[max_tracked_types]{};
+    size_t durations_count_{0};
+    uint32_t last_activity_ms_{0};
+    bool has_activity_{false};
+    bus_usage_t usage_{};
+    bool has_usage_{false};
+
+    void record_burst(burst_origin_t origin, uint32_t start_ms, uint32_t end_ms);
+    void learn_duration(uint8_t type, uint32_t duration_ms);
+    void add_usage(burst_origin_t origin, uint32_t start_ms, uint32_t end_ms);
+    static uint32_t smooth(uint32_t learned, uint32_t sample) {
+        return learned == 0 ? sample : (learned * 3 + sample) / 4;
+    }
+};
+
+} // namespace hwp
+} // namespace esphome
@@ -35,6 +35,8 @@
 #include <iostream>
 #include <sstream>
 
+#include "AllocTelemetry.h"
+
 namespace esphome {
 namespace hwp {
 
@@ -81,6 +83,7 @@ class CS : public std::stringstream {
     // Constructor: accept a specific base color and highlight color
     CS(Color base_color = Color::fg_default) : _base_color(base_color) { apply_settings(); }
     void apply_settings() {
+        HWP_ALLOC_SCOPE(ALLOC_SITE_CS);
         bc = ansi_color_code(_base_color); // Store base color ANSI sequence
         // hc = ansi_color_code(_highlight_color);         // Store highlight color ANSI sequence
         rsc = "\033[0m" + ansi_color_code(_base_color); // Reset all formats and restore base color
@@ -107,6 +110,7 @@ class CS : public std::stringstream {
 
     // Return the content of the stream with applied color formatting
     std::string str() const {
+        HWP_ALLOC_SCOPE(ALLOC_SITE_CS);
         std::stringstream colored_stream;
         if (_changed_base_color) {
             colored_stream << bc; // Apply base color at the start if requested
@@ -0,0 +1,225 @@
+/**
+ * @file CommandTracker.cpp
+ * @brief Follows the commands queued for the heater until they are confirmed or fail.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "CommandTracker.h"
+#include <cstring>
+
+namespace esphome {
+namespace hwp {
+
+const char* CommandTracker::outcome_to_string(command_outcome_t outcome) {
+    switch (outcome) {
+    case COMMAND_CONFIRMED:
+        return "confirmed";
+    case COMMAND_TIMED_OUT:
+        return "timeout";
+    case COMMAND_EXPIRED:
+        return "expired";
+    case COMMAND_DROPPED:
+        return "dropped";
+    case COMMAND_ABANDONED:
+        return "collision";
+    default:
+        return "unknown";
+    }
+}
+
+bool CommandTracker::is_echo(const hp_packetdata_t& sent, const hp_packetdata_t& received) {
+    if (sent.get_type() != received.get_type() || sent.data_len != received.data_len) {
+        return false;
+    }
+    // payload only: the type byte matches and the checksum follows the payload
+    return memcmp(sent.data + 1, received.data + 1, sent.get_checksum_pos() - 1) == 0;
+}
+
+command_ticket_t CommandTracker::open(
+    const std::vector<std::shared_ptr<BaseFrame>>& frames, uint32_t now_ms) {
+    if (frames.empty()) return no_command_ticket;
+    this->spinlock_.lock();
+    command_ticket_t ticket = this->next_ticket_++;
+    if (this->next_ticket_ == no_command_ticket) this->next_ticket_++;
+    this->tickets_.push_back({ticket, now_ms, static_cast<uint8_t>(frames.size())});
+    for (const auto& frame : frames) {
+        this->frames_.push_back({ticket, frame, 0, false});
+    }
+    this->stats_.issued++;
+    this->spinlock_.unlock();
+    return ticket;
+}
+
+void CommandTracker::on_sent(
+    const std::vector<std::shared_ptr<BaseFrame>>& frames, uint32_t now_ms) {
+    this->spinlock_.lock();
+    for (auto& tracked : this->frames_) {
+        for (const auto& frame : frames) {
+            if (tracked.frame == frame) {
+                tracked.sent = true;
+                tracked.sent_ms = now_ms;
+                break;
+            }
+        }
+    }
+    this->spinlock_.unlock();
+}
+
+void CommandTracker::on_requeued(const std::vector<std::shared_ptr<BaseFrame>>& frames) {
+    this->spinlock_.lock();
+    for (auto& tracked : this->frames_) {
+        for (const auto& frame : frames) {
+            if (tracked.frame == frame) {
+                tracked.sent = false;
+                break;
+            }
+        }
+    }
+    this->spinlock_.unlock();
+}
+
+void CommandTracker::on_merged(
+    const BaseFrame& replaced, const std::shared_ptr<BaseFrame>& frame) {
+    this->spinlock_.lock();
+    for (auto& tracked : this->frames_) {
+        if (tracked.frame.get() == &replaced) {
+            // a frame put back after a collision may be merged: it waits to be sent again
+            tracked.frame = frame;
+            tracked.sent = false;
+        }
+    }
+    this->spinlock_.unlock();
+}
+
+void CommandTracker::on_discarded(
+    const BaseFrame& frame, command_outcome_t outcome, uint32_t now_ms) {
+    this->spinlock_.lock();
+    // merged commands share the frame, each of their tickets fails
+    bool failed = true;
+    while (failed) {
+        failed = false;
+        for (const auto& tracked : this->frames_) {
+            if (tracked.frame.get() == &frame) {
+                // fail() removes the frames of the ticket, start over
+                this->fail(tracked.ticket, outcome, frame.packet.get_type(), now_ms);
+                failed = true;
+                break;
+            }
+        }
+    }
+    this->spinlock_.unlock();
+}
+
+void CommandTracker::on_heater_frame(const BaseFrame& frame, uint32_t now_ms) {
+    this->spinlock_.lock();
+    for (auto it = this->frames_.begin(); it != this->frames_.end();) {
+        if (!it->sent || !is_echo(it->frame->packet, frame.packet)) {
+            ++it;
+            continue;
+        }
+        command_ticket_t ticket = it->ticket;
+        it = this->frames_.erase(it);
+        ticket_state_t* state = this->find_ticket(ticket);
+        if (state != nullptr && --state->frames_left == 0) {
+            this->confirm(ticket, frame.packet.get_type(), now_ms);
+        }
+    }
+    this->spinlock_.unlock();
+}
+
+bool CommandTracker::take_result(command_result_t* result, uint32_t now_ms) {
+    this->spinlock_.lock();
+    bool timed_out = true;
+    while (timed_out) {
+        timed_out = false;
+        for (const auto& tracked : this->frames_) {
+            if (tracked.sent && now_ms - tracked.sent_ms >= this->timeout_ms_) {
+                // fail() removes the frames of the ticket, start over
+                this->fail(tracked.ticket, COMMAND_TIMED_OUT, tracked.frame->packet.get_type(),
+                    now_ms);
+                timed_out = true;
+                break;
+            }
+        }
+    }
+    bool found = !this->results_.empty();
+    if (found) {
+        *result = this->results_.front();
+        this->results_.pop_front();
+    }
+    this->spinlock_.unlock();
+    return found;
+}
+
+CommandTracker::ticket_state_t* CommandTracker::find_ticket(command_ticket_t ticket) {
+    for (auto& state : this->tickets_) {
+        if (state.ticket == ticket) return &state;
+    }
+    return nullptr;
+}
+
+void CommandTracker::fail(
+    command_ticket_t ticket, command_outcome_t outcome, uint8_t type, uint32_t now_ms) {
+    for (auto it = this->frames_.begin(); it != this->frames_.end();) {
+        it = it->ticket == ticket ? this->frames_.erase(it) : it + 1;
+    }
+    for (auto it = this->tickets_.begin(); it != this->tickets_.end(); ++it) {
+        if (it->ticket == ticket) {
+            this->add_result({ticket, outcome, type, now_ms - it->queued_ms});
+            this->tickets_.erase(it);
+            this->stats_.failed++;
+            break;
+        }
+    }
+}
+
+void CommandTracker::confirm(command_ticket_t ticket, uint8_t type, uint32_t now_ms) {
+    for (auto it = this->tickets_.begin(); it != this->tickets_.end(); ++it) {
+        if (it->ticket == ticket) {
+            this->add_result({ticket, COMMAND_CONFIRMED, type, now_ms - it->queued_ms});
+            this->tickets_.erase(it);
+            this->stats_.confirmed++;
+            break;
+        }
+    }
+}
+
+void CommandTracker::add_result(const command_result_t& result) {
+    if (this->results_.size() >= max_results) {
+        this->results_.pop_front();
+        this->stats_.lost_results++;
+    }
+    this->results_.push_back(result);
+}
+
+} // namespace hwp
+} // namespace esphome
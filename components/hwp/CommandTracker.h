@@ -0,0 +1,175 @@
+/**
+ * @file CommandTracker.h
+ * @brief Follows the commands queued for the heater until they are confirmed or fail.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "SpinLock.h"
+#include "base_frame.h"
+
+namespace esphome {
+namespace hwp {
+
+/// Identifies the frames queued by one control call; 0 means nothing was queued.
+typedef uint32_t command_ticket_t;
+static constexpr command_ticket_t no_command_ticket = 0;
+
+/**
+ * @brief How a command ended.
+ */
+typedef enum {
+    COMMAND_CONFIRMED, ///< The heater echoed every frame of the command
+    COMMAND_TIMED_OUT, ///< A frame was sent but the heater never echoed it
+    COMMAND_EXPIRED,   ///< A frame waited past its deadline in the transmit queue
+    COMMAND_DROPPED,   ///< A frame was evicted from the full transmit queue
+    COMMAND_ABANDONED, ///< A frame kept colliding and was given up on
+} command_outcome_t;
+
+/**
+ * @brief A command that ended, as reported to the automations.
+ */
+typedef struct {
+    command_ticket_t ticket;
+    command_outcome_t outcome;
+    uint8_t frame_type;  ///< Type of the frame that failed, or of the last one confirmed
+    uint32_t elapsed_ms; ///< Time from queuing to the outcome
+} command_result_t;
+
+/**
+ * @brief Counters describing how the tracked commands ended.
+ */
+typedef struct {
+    uint32_t issued;
+    uint32_t confirmed;
+    uint32_t failed;
+    uint32_t lost_results; ///< Results discarded because the main loop did not collect them
+} command_stats_t;
+
+/**
+ * @class CommandTracker
+ * @brief Follows each frame of a command from the transmit queue until the heater echoes it.
+ *
+ * A control call gets a ticket covering all the frames it queued. The ticket is confirmed
+ * once a heater frame carrying the same payload was decoded for each of them, and fails as
+ * soon as one of its frames is dropped, expires, is abandoned after collisions or is not
+ * echoed within the timeout. A frame merged into a newer one of the same type is not a
+ * failure: the newer frame carries the change, so the ticket follows it.
+ *
+ * Events come from both the main loop (queuing) and the bus task (sending, decoding), so
+ * the tracker takes the time as a parameter and only holds a spinlock; the results are
+ * collected from the main loop to run the automations.
+ */
+class CommandTracker {
+  public:
+    static constexpr uint32_t default_timeout_ms = 30 * 1000;
+    static constexpr size_t max_results = 16;
+
+    static const char* outcome_to_string(command_outcome_t outcome);
+    /**
+     * @brief Tells whether a heater frame carries the payload that was sent.
+     */
+    static bool is_echo(const hp_packetdata_t& sent, const hp_packetdata_t& received);
+
+    /**
+     * @brief Sets how long the heater has to echo a frame once it was sent.
+     */
+    void set_timeout(uint32_t timeout_ms) { this->timeout_ms_ = timeout_ms; }
+    uint32_t get_timeout() const { return this->timeout_ms_; }
+
+    /**
+     * @brief Creates a ticket for the given frames, which must be queued right after.
+     * @return The ticket, or no_command_ticket if there are no frames.
+     */
+    command_ticket_t open(const std::vector<std::shared_ptr<BaseFrame>>& frames, uint32_t now_ms);
+
+    /// @brief The frames were handed over to the transmitter.
+    void on_sent(const std::vector<std::shared_ptr<BaseFrame>>& frames, uint32_t now_ms);
+    /// @brief The frames were put back in the transmit queue after a collision.
+    void on_requeued(const std::vector<std::shared_ptr<BaseFrame>>& frames);
+    /// @brief A pending frame was replaced by a newer one of the same type, which carries its
+    /// changes: the tickets of the replaced frame now wait for the echo of the newer one.
+    void on_merged(const BaseFrame& replaced, const std::shared_ptr<BaseFrame>& frame);
+    /// @brief The frame left the transmit queue without being sent.
+    void on_discarded(const BaseFrame& frame, command_outcome_t outcome, uint32_t now_ms);
+    /// @brief A frame sent by the heater was decoded.
+    void on_heater_frame(const BaseFrame& frame, uint32_t now_ms);
+
+    /**
+     * @brief Times out the frames the heater did not echo, then pops the oldest result.
+     * @return false If no command ended since the last call.
+     */
+    bool take_result(command_result_t* result, uint32_t now_ms);
+
+    /// @brief Whether frames are being followed, to skip the echo check otherwise.
+    bool is_tracking() const { return !this->frames_.empty(); }
+    size_t get_pending_count() const { return this->tickets_.size(); }
+    const command_stats_t& get_stats() const { return this->stats_; }
+
+  protected:
+    typedef struct {
+        command_ticket_t ticket;
+        uint32_t queued_ms;
+        uint8_t frames_left;
+    } ticket_state_t;
+
+    typedef struct {
+        command_ticket_t ticket;
+        std::shared_ptr<BaseFrame> frame;
+        uint32_t sent_ms;
+        bool sent;
+    } tracked_frame_t;
+
+    // the lock must be held by the callers
+    ticket_state_t* find_ticket(command_ticket_t ticket);
+    void fail(command_ticket_t ticket, command_outcome_t outcome, uint8_t type, uint32_t now_ms);
+    void confirm(command_ticket_t ticket, uint8_t type, uint32_t now_ms);
+    void add_result(const command_result_t& result);
+
+    Spinlock spinlock_;
+    std::deque<ticket_state_t> tickets_;
+    std::deque<tracked_frame_t> frames_;
+    std::deque<command_result_t> results_;
+    command_ticket_t next_ticket_{1};
+    uint32_t timeout_ms_{default_timeout_ms};
+    command_stats_t stats_{};
+};
+
+} // namespace hwp
+} // namespace esphome
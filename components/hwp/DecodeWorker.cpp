@@ -0,0 +1,102 @@
+/**
+ * @file DecodeWorker.cpp
+ * @brief Implementation of the shared decode worker.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "DecodeWorker.h"
+#include <algorithm>
+#include "AllocTelemetry.h"
+#include "Bus.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace hwp {
+
+Bus* DecodeWorker::buses_[DecodeWorker::max_buses] = {};
+volatile size_t DecodeWorker::bus_count_ = 0;
+TaskHandle_t DecodeWorker::task_handle_ = nullptr;
+uint32_t DecodeWorker::stack_size_ = DecodeWorker::default_stack_size;
+bool DecodeWorker::stack_size_set_ = false;
+int8_t DecodeWorker::core_ = task_core_any;
+uint8_t DecodeWorker::priority_ = default_task_priority;
+bool DecodeWorker::affinity_set_ = false;
+
+bool DecodeWorker::add_bus(Bus* bus, uint8_t* index) {
+    if (bus_count_ >= max_buses) {
+        ESP_LOGE(TAG_BUS, "Cannot decode more than %u buses", max_buses);
+        return false;
+    }
+    if (task_handle_ == nullptr) {
+        ESP_LOGD(TAG_BUS, "Creating decode worker task with a %u bytes stack", stack_size_);
+        if (xTaskCreatePinnedToCore(task, "RX", stack_size_, nullptr, priority_, &task_handle_,
+                core_ == task_core_any ? tskNO_AFFINITY : core_) != pdPASS) {
+            ESP_LOGE(TAG_BUS, "Unable to create the decode worker task");
+            task_handle_ = nullptr;
+            return false;
+        }
+    }
+    *index = bus_count_;
+    buses_[bus_count_] = bus;
+    // publish the bus only once its slot is filled, the worker may be running already
+    bus_count_ = bus_count_ + 1;
+    ESP_LOGD(TAG_BUS, "Bus #%u added to the decode worker", *index);
+    return true;
+}
+
+void DecodeWorker::task(void* arg) {
+    AllocTelemetry::register_task(ALLOC_CONTEXT_RX, xTaskGetCurrentTaskHandle());
+    uint32_t wait_ms = fallback_poll_ms;
+    while (true) {
+        uint32_t notified = 0;
+        // one more tick so a short deadline does not wake us up before it is due
+        TickType_t ticks = wait_ms == 0 ? 0 : pdMS_TO_TICKS(wait_ms) + 1;
+        xTaskNotifyWait(0, UINT32_MAX, &notified, ticks);
+        wait_ms = service_buses();
+    }
+    vTaskDelete(nullptr);
+}
+
+uint32_t DecodeWorker::service_buses() {
+    for (size_t i = 0; i < bus_count_; i++) {
+        buses_[i]->service_rx();
+    }
+    // transmit once the frames of this wake-up are decoded, echoes and timeline included
+    uint32_t wait_ms = fallback_poll_ms;
+    for (size_t i = 0; i < bus_count_; i++) {
+        wait_ms = std::min(wait_ms, buses_[i]->service_tx());
+    }
+    return wait_ms;
+}
+
+} // namespace hwp
+} // namespace esphome
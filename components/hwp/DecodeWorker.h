@@ -0,0 +1,169 @@
+/**
+ * @file DecodeWorker.h
+ * @brief Single task decoding the pulses of every bus on the chip.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/optional.h"
+
+namespace esphome {
+namespace hwp {
+
+class Bus;
+
+/**
+ * @class DecodeWorker
+ * @brief Services the ring buffers and the transmitters of all the buses from one shared task.
+ *
+ * Each bus ISR pushes pulses into its own ring buffer, then sets the bit matching its index
+ * in the worker notification value. The worker drains every bus it knows about when woken up.
+ * The last frame of a burst is followed by silence: each bus frame end timer sets its bit
+ * once the line has been idle for `frame_end_threshold_ms`, and the worker also polls every
+ * `fallback_poll_ms` in case a timer could not be created.
+ *
+ * Each bus transmitter is then stepped (see Bus::service_tx()), and the worker sleeps until
+ * the earliest deadline any of them asked for. Frames queued for transmission and the end of
+ * the levels played by a bus step timer wake the worker up as well.
+ *
+ * Neither decoding nor transmitting blocks, so a single task (and a single stack) handles any
+ * number of buses; the per-bus cost is limited to the ring buffer and two one-shot timers.
+ */
+class DecodeWorker {
+  public:
+    static constexpr size_t max_buses = 8;
+    static constexpr uint32_t default_stack_size = 1024 * 15;
+    static constexpr uint32_t fallback_poll_ms = 1000;
+
+    /**
+     * @brief Adds a bus to the worker, starting the worker task on first use.
+     *
+     * The bus ring buffer must be created before it is added.
+     *
+     * @param bus The bus to service.
+     * @param index Receives the bus index, to be passed to notify_from_isr().
+     * @return false If the maximum number of buses is reached or the task could not start.
+     */
+    static bool add_bus(Bus* bus, uint8_t* index);
+
+    /**
+     * @brief Wakes the worker up from a bus ISR.
+     */
+    static inline void IRAM_ATTR notify_from_isr(uint8_t index, BaseType_t* woken) {
+        if (task_handle_ != nullptr) {
+            xTaskNotifyFromISR(task_handle_, 1UL << index, eSetBits, woken);
+        }
+    }
+
+    /**
+     * @brief Wakes the worker up from a task, or from an esp_timer callback.
+     */
+    static inline void notify(uint8_t index) {
+        if (task_handle_ != nullptr) {
+            xTaskNotify(task_handle_, 1UL << index, eSetBits);
+        }
+    }
+
+    /**
+     * @brief Sets the worker stack size, in bytes.
+     *
+     * Only effective before the first bus is added. When several heaters request a size, the
+     * largest one is kept since they all share the same task.
+     */
+    static void set_stack_size(uint32_t size) {
+        if (task_handle_ == nullptr && (!stack_size_set_ || size > stack_size_)) {
+            stack_size_ = size;
+            stack_size_set_ = true;
+        }
+    }
+    static uint32_t get_stack_size() { return stack_size_; }
+    /**
+     * @brief Sets the core (task_core_any for none) and priority of the worker task.
+     *
+     * Only effective before the first bus is added. The highest requested priority is kept,
+     * along with the core that came with it.
+     */
+    static void set_task_affinity(int8_t core, uint8_t priority) {
+        if (task_handle_ == nullptr && (!affinity_set_ || priority > priority_)) {
+            core_ = core;
+            priority_ = priority;
+            affinity_set_ = true;
+        }
+    }
+    static int8_t get_task_core() { return core_; }
+    static uint8_t get_task_priority() { return priority_; }
+    /**
+     * @brief Gets the smallest amount of stack that was left unused so far, in bytes.
+     *
+     * @return The high-water mark, or an empty optional if the worker is not running.
+     */
+    static optional<uint32_t> get_stack_free() {
+        if (task_handle_ == nullptr) return {};
+        return uxTaskGetStackHighWaterMark(task_handle_);
+    }
+
+    /**
+     * @brief Runs one pass of the worker: decodes what every bus captured, then steps every
+     * transmitter.
+     *
+     * Called by the worker task on each wake-up, and directly by the host simulation.
+     *
+     * @return How long the worker may sleep, in milliseconds.
+     */
+    static uint32_t service_buses();
+
+    static size_t get_bus_count() { return bus_count_; }
+    static TaskHandle_t get_task_handle() { return task_handle_; }
+
+  protected:
+    static void task(void* arg);
+
+    static Bus* buses_[max_buses];
+    static volatile size_t bus_count_;
+    static TaskHandle_t task_handle_;
+    static uint32_t stack_size_;
+    static bool stack_size_set_;
+    static int8_t core_;
+    static uint8_t priority_;
+    static bool affinity_set_;
+};
+
+} // namespace hwp
+} // namespace esphome
@@ -32,6 +32,7 @@
  */
 
 #include "Decoder.h"
+#include <algorithm>
 #include "base_frame.h"
 #include "esphome/core/log.h"
 namespace esphome {
@@ -42,7 +43,9 @@ Decoder::Decoder()
 
 Decoder::Decoder(const Decoder& other)
     : BaseFrame(other), passes_count(0), current_byte_value(other.current_byte_value),
-      bit_current_index(other.bit_current_index), started(other.started) {}
+      bit_current_index(other.bit_current_index), started(other.started) {
+    memcpy(this->bit_margins_, other.bit_margins_, sizeof(this->bit_margins_));
+}
 
 Decoder& Decoder::operator=(const Decoder& other) {
     if (this != &other) {
@@ -51,6 +54,7 @@ Decoder& Decoder::operator=(const Decoder& other) {
         bit_current_index = other.bit_current_index;
         started = other.started;
         passes_count = other.passes_count;
+        memcpy(this->bit_margins_, other.bit_margins_, sizeof(this->bit_margins_));
     }
     return *this;
 }
@@ -72,7 +76,7 @@ void Decoder::reset(const char* msg) {
     this->packet.reset();
 }
 
-std::shared_ptr<BaseFrame> Decoder::finalize(heat_pump_data_t& hp_data) {
+std::shared_ptr<BaseFrame> Decoder::finalize(heat_pump_data_t& hp_data, FrameRegistry& registry) {
     bool inverted = false;
     this->source_ = SOURCE_UNKNOWN;
     this->finalized = false;
@@ -92,7 +96,7 @@ std::shared_ptr<BaseFrame> Decoder::finalize(heat_pump_data_t& hp_data) {
             this->source_ = SOURCE_CONTROLLER;
         }
         finalized = true;
-        specialized = process(hp_data);
+        specialized = process(hp_data, registry);
         specialized->set_frame_time_ms(millis());
         ESP_LOGVV(TAG_DECODING, "Finalize()->frame is %s with type %s",
             this->finalized ? "FINALIZED" : "NOT FINALIZED", specialized->type_string());
@@ -103,11 +107,15 @@ std::shared_ptr<BaseFrame> Decoder::finalize(heat_pump_data_t& hp_data) {
 
 bool Decoder::is_valid() const { return (finalized && BaseFrame::is_valid()); }
 
-void Decoder::append_bit(bool long_duration) {
+void Decoder::append_bit(bool long_duration, uint16_t margin_us) {
     if (!started) {
         ESP_LOGW(TAG_DECODING, "Frame not started. Ignoring bit");
         return;
     }
+    size_t bit = this->packet.data_len * 8 + bit_current_index;
+    if (bit < sizeof(this->bit_margins_) / sizeof(this->bit_margins_[0])) {
+        this->bit_margins_[bit] = margin_us;
+    }
     if (long_duration) {
         set_bit(&current_byte_value, bit_current_index);
     }
@@ -158,6 +166,17 @@ bool Decoder::is_short_bit(const rmt_item32_t* item) {
     return matches_duration(get_high_duration(item), bit_short_high_duration_ms * 1000) &&
            matches_duration(get_low_duration(item), bit_low_duration_ms * 1000);
 }
+uint16_t Decoder::get_bit_margin(const rmt_item32_t* item, bool long_duration) {
+    uint32_t high_target =
+        (long_duration ? bit_long_high_duration_ms : bit_short_high_duration_ms) * 1000;
+    uint32_t low_target = bit_low_duration_ms * 1000;
+    uint32_t high = get_high_duration(item);
+    uint32_t low = get_low_duration(item);
+    uint32_t error = std::max(high > high_target ? high - high_target : high_target - high,
+        low > low_target ? low - low_target : low_target - low);
+    return error >= pulse_duration_threshold_us ? 0 : pulse_duration_threshold_us - error;
+}
+
 bool Decoder::is_frame_end(const rmt_item32_t* item) {
     return Decoder::get_high_duration(item) == 0 || Decoder::get_low_duration(item) == 0 ||
            Decoder::matches_duration(Decoder::get_high_duration(item), frame_end_threshold_ms*1000);
@@ -167,6 +186,7 @@ bool Decoder::is_started() const { return started; }
 void Decoder::set_started(bool value) { started = value; }
 
 void Decoder::debug(const char* msg) {
+    HWP_ALLOC_SCOPE(ALLOC_SITE_DECODER_DEBUG);
     std::stringstream oss;
     bool debug_status = log_active(TAG_DECODING);
 
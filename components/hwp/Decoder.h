@@ -45,9 +45,10 @@ namespace esphome {
       Decoder& operator=(const Decoder& other);
 
       void reset(const char* msg = "");
-      std::shared_ptr<BaseFrame> finalize(heat_pump_data_t& hp_data);
+      std::shared_ptr<BaseFrame> finalize(heat_pump_data_t& hp_data, FrameRegistry& registry);
       bool is_valid() const;
-      void append_bit(bool long_duration);
+      /// @param margin_us How far the pulse timings were from the accepted range limits.
+      void append_bit(bool long_duration, uint16_t margin_us = pulse_duration_threshold_us);
       void start_new_frame();
       static int32_t get_high_duration(const rmt_item32_t* item);
       static uint32_t get_low_duration(const rmt_item32_t* item);
@@ -56,6 +57,11 @@ namespace esphome {
       static bool is_long_bit(const rmt_item32_t* item);
       static bool is_short_bit(const rmt_item32_t* item);
       static bool is_frame_end(const rmt_item32_t* item);
+      /// @brief Distance of a bit pulse to the limits of the long or short bit timings, in us.
+      /// The lower the margin, the more likely the bit was misread.
+      static uint16_t get_bit_margin(const rmt_item32_t* item, bool long_duration);
+      /// @brief Timing margin of each received bit, indexed like the packet bits.
+      const uint16_t* get_bit_margins() const { return bit_margins_; }
       bool is_started() const;
       void set_started(bool value);
       void debug(const char* msg = "");
@@ -67,6 +73,7 @@ namespace esphome {
       uint8_t current_byte_value;
       uint8_t bit_current_index;
       bool started;
+      uint16_t bit_margins_[frame_data_length * 8];
     };
 
   }  // namespace hwp
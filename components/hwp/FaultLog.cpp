@@ -0,0 +1,144 @@
+/**
+ * @file FaultLog.cpp
+ * @brief Implementation of the heater fault log.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "FaultLog.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace hwp {
+
+static const char* const TAG_FAULTS = "hwp.faults";
+
+void FaultLog::setup(uint32_t key) {
+    this->preference_ = global_preferences->make_preference<fault_log_storage_t>(key, true);
+    fault_log_storage_t saved;
+    if (!this->preference_.load(&saved)) return;
+    if (!this->is_valid(saved)) {
+        ESP_LOGW(TAG_FAULTS, "Discarding an invalid saved fault log");
+        return;
+    }
+    this->storage_ = saved;
+    ESP_LOGI(TAG_FAULTS, "Restored %u fault event(s)", this->storage_.count);
+}
+
+bool FaultLog::is_valid(const fault_log_storage_t& saved) const {
+    if (saved.version != storage_version || saved.count > fault_log_capacity ||
+        saved.head >= fault_log_capacity) {
+        return false;
+    }
+    for (size_t i = 0; i < saved.count; i++) {
+        size_t slot = (saved.head + fault_log_capacity - 1 - i) % fault_log_capacity;
+        if (saved.events[slot].status_index >= error_codes_.size()) return false;
+    }
+    return true;
+}
+
+void FaultLog::record(uint8_t status_index, const heat_pump_data_t& hp_data, uint32_t now_ms) {
+    fault_event_t& event = this->storage_.events[this->storage_.head];
+    if (hp_data.time.has_value()) {
+        event.timestamp = static_cast<uint32_t>(hp_data.time.value());
+        event.flags = FAULT_EVENT_HEATER_TIME;
+    } else {
+        event.timestamp = now_ms / 1000;
+        event.flags = 0;
+    }
+    event.status_index = status_index;
+    event.inlet_x10 = to_x10(hp_data.t02_temperature_inlet);
+    event.outlet_x10 = to_x10(hp_data.t03_temperature_outlet);
+    event.coil_x10 = to_x10(hp_data.t04_temperature_coil);
+    event.ambient_x10 = to_x10(hp_data.t05_temperature_ambient);
+
+    this->storage_.head = (this->storage_.head + 1) % fault_log_capacity;
+    if (this->storage_.count < fault_log_capacity) this->storage_.count++;
+    if (this->pending_ == 0) this->first_pending_ms_ = now_ms;
+    if (this->pending_ < UINT8_MAX) this->pending_++;
+    ESP_LOGI(TAG_FAULTS, "%s", this->format(event).c_str());
+}
+
+void FaultLog::flush(uint32_t now_ms, bool force) {
+    if (this->pending_ == 0) return;
+    if (!force && this->pending_ < this->flush_batch_ &&
+        now_ms - this->first_pending_ms_ < this->flush_interval_ms_) {
+        return;
+    }
+    if (this->preference_.save(&this->storage_)) {
+        this->flash_writes_++;
+        ESP_LOGD(TAG_FAULTS, "Saved %u new fault event(s)", this->pending_);
+        this->pending_ = 0;
+    } else {
+        ESP_LOGW(TAG_FAULTS, "Unable to save the fault log");
+    }
+}
+
+void FaultLog::clear() {
+    this->storage_.head = 0;
+    this->storage_.count = 0;
+    this->preference_.save(&this->storage_);
+    this->flash_writes_++;
+    this->pending_ = 0;
+}
+
+const fault_event_t& FaultLog::get(size_t index) const {
+    size_t slot = (this->storage_.head + fault_log_capacity - 1 - index) % fault_log_capacity;
+    return this->storage_.events[slot];
+}
+
+std::string FaultLog::format(const fault_event_t& event) const {
+    const ErrorEntry& entry = get_entry(event);
+    char buffer[160];
+    auto temperature = [](int16_t value, char* out, size_t len) {
+        if (value == fault_temperature_unknown) {
+            snprintf(out, len, "?");
+        } else {
+            snprintf(out, len, "%.1f", value / 10.0f);
+        }
+    };
+    char inlet[8], outlet[8], coil[8], ambient[8];
+    temperature(event.inlet_x10, inlet, sizeof(inlet));
+    temperature(event.outlet_x10, outlet, sizeof(outlet));
+    temperature(event.coil_x10, coil, sizeof(coil));
+    temperature(event.ambient_x10, ambient, sizeof(ambient));
+    snprintf(buffer, sizeof(buffer), "%s %" PRIu32 "s: %s %s (in %s, out %s, coil %s, amb %s)",
+        (event.flags & FAULT_EVENT_HEATER_TIME) ? "time" : "uptime", event.timestamp, entry.code,
+        entry.description, inlet, outlet, coil, ambient);
+    return buffer;
+}
+
+} // namespace hwp
+} // namespace esphome
@@ -0,0 +1,154 @@
+/**
+ * @file FaultLog.h
+ * @brief Fixed-size log of the heater faults, persisted to flash in batches.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "HeaterStatus.h"
+#include "Schema.h"
+#include "esphome/core/preferences.h"
+
+namespace esphome {
+namespace hwp {
+
+static constexpr size_t fault_log_capacity = 16;
+static constexpr int16_t fault_temperature_unknown = INT16_MIN;
+static constexpr uint32_t default_fault_log_flush_interval_ms = 10 * 60 * 1000;
+static constexpr uint8_t default_fault_log_flush_batch = 4;
+
+/**
+ * @brief A heater status change, with the temperatures seen when it happened.
+ */
+typedef struct {
+    uint32_t timestamp;      ///< Heater clock (epoch seconds) or uptime seconds, see flags
+    uint8_t status_index;    ///< Position of the status in error_codes_
+    uint8_t flags;           ///< FAULT_EVENT_* flags
+    int16_t inlet_x10;       ///< T02, tenths of degrees
+    int16_t outlet_x10;      ///< T03, tenths of degrees
+    int16_t coil_x10;        ///< T04, tenths of degrees
+    int16_t ambient_x10;     ///< T05, tenths of degrees
+} fault_event_t;
+
+static constexpr uint8_t FAULT_EVENT_HEATER_TIME = 0x01; ///< timestamp comes from the heater clock
+
+/**
+ * @class FaultLog
+ * @brief Ring buffer of the last heater status changes, surviving reboots.
+ *
+ * Events are kept in RAM and only written to the preferences once a batch of them is pending,
+ * or after the flush interval elapsed since the first unsaved one. A fault that flaps every
+ * update interval therefore costs one flash write per interval at most.
+ */
+class FaultLog {
+  public:
+    /**
+     * @brief Loads the saved events.
+     *
+     * @param key Preference key, stable across firmware builds.
+     */
+    void setup(uint32_t key);
+    /**
+     * @brief Sets how the events are batched before being written to flash.
+     *
+     * @param interval_ms Longest time an event stays unsaved.
+     * @param batch Number of unsaved events that triggers a write right away.
+     */
+    void set_flush_policy(uint32_t interval_ms, uint8_t batch) {
+        this->flush_interval_ms_ = interval_ms;
+        this->flush_batch_ = batch == 0 ? 1 : batch;
+    }
+    /**
+     * @brief Records a status change.
+     */
+    void record(uint8_t status_index, const heat_pump_data_t& hp_data, uint32_t now_ms);
+    /**
+     * @brief Writes the pending events if the flush policy says so.
+     *
+     * @param force True to write any pending event right away (e.g. before a reboot).
+     */
+    void flush(uint32_t now_ms, bool force = false);
+    void clear();
+
+    size_t size() const { return this->storage_.count; }
+    /**
+     * @brief Gets an event, 0 being the most recent one.
+     */
+    const fault_event_t& get(size_t index) const;
+    /**
+     * @brief Gets the status of the most recent event, or the waiting status when empty.
+     */
+    uint8_t get_last_status() const {
+        return this->size() == 0 ? error_index_waiting : this->get(0).status_index;
+    }
+    /**
+     * @brief Gets the error_codes_ entry of an event, falling back to the waiting status.
+     */
+    static const ErrorEntry& get_entry(const fault_event_t& event) {
+        return error_codes_[event.status_index < error_codes_.size() ? event.status_index
+                                                                     : error_index_waiting];
+    }
+    std::string format(const fault_event_t& event) const;
+    uint32_t get_flash_writes() const { return this->flash_writes_; }
+    uint8_t get_pending() const { return this->pending_; }
+
+  protected:
+    static constexpr uint32_t storage_version = 1;
+    typedef struct {
+        uint32_t version;
+        uint16_t head; ///< Slot the next event is written to
+        uint16_t count;
+        fault_event_t events[fault_log_capacity];
+    } fault_log_storage_t;
+
+    fault_log_storage_t storage_{storage_version, 0, 0, {}};
+    ESPPreferenceObject preference_;
+    uint32_t flush_interval_ms_{default_fault_log_flush_interval_ms};
+    uint8_t flush_batch_{default_fault_log_flush_batch};
+    uint8_t pending_{0};
+    uint32_t first_pending_ms_{0};
+    uint32_t flash_writes_{0};
+
+    static int16_t to_x10(const optional<float>& value) {
+        if (!value.has_value()) return fault_temperature_unknown;
+        return static_cast<int16_t>(value.value() * 10);
+    }
+    bool is_valid(const fault_log_storage_t& saved) const;
+};
+
+} // namespace hwp
+} // namespace esphome
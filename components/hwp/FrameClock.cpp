@@ -32,13 +32,14 @@
  */
 
 #include "FrameClock.h"
+#include "FrameTypes.h"
 
 namespace esphome {
 namespace hwp {
 
 CLASS_ID_DECLARATION(esphome::hwp::FrameClock)
 
-std::shared_ptr<BaseFrame> FrameClock::create() { return std::make_shared<FrameClock>(); }
+std::shared_ptr<BaseFrame> FrameClock::create() { return make_pooled_frame<FrameClock>(); }
 
 const char *FrameClock::type_string() const { return "CLOCK"; }
 
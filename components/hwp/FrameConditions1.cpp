@@ -32,6 +32,7 @@
  */
 
 #include "FrameConditions1.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
@@ -44,7 +45,7 @@ CLASS_ID_DECLARATION(esphome::hwp::FrameConditions1);
  * @return A shared pointer to a newly created FrameConditions1 instance.
  */
 std::shared_ptr<BaseFrame> FrameConditions1::create() {
-    return std::make_shared<FrameConditions1>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConditions1>(); // Create a FrameTemperature if type matches
 }
 
 const char* FrameConditions1::type_string() const { return "COND_1    "; }
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConditions1B.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "FrameConditions1.h"
 #include "Schema.h"
@@ -45,7 +46,7 @@ CLASS_ID_DECLARATION(esphome::hwp::FrameConditions1B);
  * @return A shared pointer to a newly created FrameConditions1B instance.
  */
 std::shared_ptr<BaseFrame> FrameConditions1B::create() {
-    return std::make_shared<FrameConditions1B>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConditions1B>(); // Create a FrameTemperature if type matches
 }
 /**
  * @brief Checks if the given frame matches the current frame class.
@@ -32,13 +32,14 @@
  */
 
 #include "FrameConditions2.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
 namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConditions2);
 std::shared_ptr<BaseFrame> FrameConditions2::create() {
-    return std::make_shared<FrameConditions2>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConditions2>(); // Create a FrameTemperature if type matches
 }
 bool FrameConditions2::matches(BaseFrame& secialized, BaseFrame& base) {
     return base.packet.get_type() == FRAME_ID_CONDITIONS2 && (base.size() == frame_data_length);
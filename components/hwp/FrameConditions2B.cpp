@@ -32,6 +32,7 @@
  */
 
 #include "FrameConditions2B.h"
+#include "FrameTypes.h"
 #include "FrameConditions2.h"
 #include "CS.h"
 #include "Schema.h"
@@ -39,7 +40,7 @@ namespace esphome {
 namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConditions2B);
 std::shared_ptr<BaseFrame> FrameConditions2B::create() {
-    return std::make_shared<FrameConditions2B>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConditions2B>(); // Create a FrameTemperature if type matches
 }
 bool FrameConditions2B::matches(BaseFrame& secialized, BaseFrame& base) {
     return base.packet.get_type() == FrameConditions2::FRAME_ID_CONDITIONS2 && (base.size() == frame_data_length_short);
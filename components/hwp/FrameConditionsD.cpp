@@ -32,6 +32,7 @@
  */
 
 #include "FrameConditionsD.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
@@ -39,7 +40,7 @@ namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConditionsD);
 static constexpr char TAG[] = "hwp";
 std::shared_ptr<BaseFrame> FrameConditionsD::create() {
-    return std::make_shared<FrameConditionsD>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConditionsD>(); // Create a FrameTemperature if type matches
 }
 const char* FrameConditionsD::type_string() const { return "COND_D    "; }
 bool FrameConditionsD::matches(BaseFrame& secialized, BaseFrame& base) {
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConf1.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 #include "esphome/components/climate/climate.h"
@@ -44,7 +45,7 @@ namespace hwp {
 constexpr char TAG[] = "hwp";
 CLASS_ID_DECLARATION(esphome::hwp::FrameConf1);
 std::shared_ptr<BaseFrame> FrameConf1::create() {
-    return std::make_shared<FrameConf1>(); //  Create a FrameConf1 if type matches
+    return make_pooled_frame<FrameConf1>(); //  Create a FrameConf1 if type matches
 }
 /**
  * @class FrameConf1
@@ -168,7 +169,7 @@ optional<std::shared_ptr<BaseFrame>> FrameConf1::control(const HWPCall& call) {
     command_frame.finalize();
     command_frame.print("TXQ", TAG, ESPHOME_LOG_LEVEL_VERBOSE, __LINE__);
     return optional<std::shared_ptr<FrameConf1>>{
-        std::make_shared<FrameConf1>(command_frame)};
+        make_pooled_frame<FrameConf1>(command_frame)};
 }
 
 void FrameConf1::traits(climate::ClimateTraits& traits, heat_pump_data_t& hp_data) {
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConf2.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "HPUtils.h"
 #include "Schema.h"
@@ -40,7 +41,7 @@ namespace hwp {
 static constexpr char TAG[] = "hwp";
 CLASS_ID_DECLARATION(esphome::hwp::FrameConf2);
 std::shared_ptr<BaseFrame> FrameConf2::create() {
-    return std::make_shared<FrameConf2>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConf2>(); // Create a FrameTemperature if type matches
 }
 bool FrameConf2::matches(BaseFrame& secialized, BaseFrame& base) {
     return base.packet.get_type() == FRAME_ID_CONF_2;
@@ -120,7 +121,7 @@ optional<std::shared_ptr<BaseFrame>> FrameConf2::control(const HWPCall& call) {
     }
     fan_mode_frame.finalize();
     fan_mode_frame.print("TXQ", TAG, ESPHOME_LOG_LEVEL_VERBOSE, __LINE__);
-    return optional<std::shared_ptr<FrameConf2>>{std::make_shared<FrameConf2>(fan_mode_frame)};
+    return optional<std::shared_ptr<FrameConf2>>{make_pooled_frame<FrameConf2>(fan_mode_frame)};
 }
 void FrameConf2::traits(climate::ClimateTraits& traits, heat_pump_data_t& hp_data) {
     hp_data.fan_mode->set_supported_fan_modes(traits);
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConf3.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
@@ -39,7 +40,7 @@ namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConf3);
 static constexpr char TAG[] = "hwp";
 std::shared_ptr<BaseFrame> FrameConf3::create() {
-    return std::make_shared<FrameConf3>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConf3>(); // Create a FrameTemperature if type matches
 }
 // FRAME_ID_t FrameConf3::get_type() const { return FRAME_SETPOINT_LIMITS; }
 const char* FrameConf3::type_string() const { return "CONFIG_3  "; }
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConf4.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
@@ -39,7 +40,7 @@ namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConf4);
 static constexpr char TAG[] = "hwp";
 std::shared_ptr<BaseFrame> FrameConf4::create() {
-    return std::make_shared<FrameConf4>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConf4>(); // Create a FrameTemperature if type matches
 }
 const char* FrameConf4::type_string() const { return "CONFIG_4  "; }
 bool FrameConf4::matches(BaseFrame& secialized, BaseFrame& base) {
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConf5.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
@@ -39,7 +40,7 @@ namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConf5);
 static constexpr char TAG[] = "hwp";
 std::shared_ptr<BaseFrame> FrameConf5::create() {
-    return std::make_shared<FrameConf5>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConf5>(); // Create a FrameTemperature if type matches
 }
 bool FrameConf5::matches(BaseFrame& secialized, BaseFrame& base) {
     return base.packet.get_type() == FRAME_ID_CONF_5;
@@ -108,7 +109,7 @@ optional<std::shared_ptr<BaseFrame>> FrameConf5::control(const HWPCall& call) {
     }
     command_frame.finalize();
     command_frame.print("TXQ", TAG, ESPHOME_LOG_LEVEL_VERBOSE, __LINE__);
-    return optional<std::shared_ptr<FrameConf5>>{std::make_shared<FrameConf5>(command_frame)};
+    return optional<std::shared_ptr<FrameConf5>>{make_pooled_frame<FrameConf5>(command_frame)};
 }
 /**
  * @brief Parses the frame data and places it into the canonical
@@ -32,6 +32,7 @@
  */
 
 #include "FrameConf6.h"
+#include "FrameTypes.h"
 #include "CS.h"
 #include "Schema.h"
 namespace esphome {
@@ -39,7 +40,7 @@ namespace hwp {
 CLASS_ID_DECLARATION(esphome::hwp::FrameConf6);
 static constexpr char TAG[] = "hwp";
 std::shared_ptr<BaseFrame> FrameConf6::create() {
-    return std::make_shared<FrameConf6>(); // Create a FrameTemperature if type matches
+    return make_pooled_frame<FrameConf6>(); // Create a FrameTemperature if type matches
 }
 const char* FrameConf6::type_string() const { return "CONFIG_6  "; }
 bool FrameConf6::matches(BaseFrame& secialized, BaseFrame& base) {
@@ -0,0 +1,113 @@
+/**
+ * @file FramePool.cpp
+ * @brief Implementation of the frame pool.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+
+#include "FramePool.h"
+#include "FrameTypes.h"
+#include "esphome/core/defines.h"
+
+#ifndef HWP_BUS_COUNT
+#define HWP_BUS_COUNT 1
+#endif
+
+namespace esphome {
+namespace hwp {
+
+// Each bus owns a registry holding one instance per frame type, plus a prototype per unknown
+// type byte seen on the bus. On top of that, a type may have a pending copy, the copy being
+// sent and a log snapshot alive at once. The pool is sized for the number of heaters in the
+// configuration (HWP_BUS_COUNT, set by the code generation); frames beyond it, e.g. from more
+// unknown type bytes than planned, are served by the heap and counted as fallbacks.
+static constexpr size_t frame_pool_learned_types = 4;
+static constexpr size_t frame_pool_depth = 4;
+static constexpr size_t frame_pool_slots =
+    HWP_BUS_COUNT * (frame_types::size * frame_pool_depth + frame_pool_learned_types);
+static constexpr size_t frame_pool_words = (frame_pool_slots + 31) / 32;
+
+Spinlock FramePool::lock_;
+frame_pool_stats_t FramePool::stats_ = {};
+static uint32_t used_[frame_pool_words] = {};
+alignas(8) static uint8_t slots_[frame_pool_slots][frame_pool_slot_size];
+
+void* FramePool::allocate(size_t size) {
+    if (size <= frame_pool_slot_size) {
+        lock_.lock();
+        for (size_t word = 0; word < frame_pool_words; word++) {
+            uint32_t free_map = ~used_[word];
+            size_t first = word * 32;
+            if (frame_pool_slots - first < 32) free_map &= (1UL << (frame_pool_slots - first)) - 1;
+            if (free_map == 0) continue;
+            size_t bit = __builtin_ctz(free_map);
+            used_[word] |= 1UL << bit;
+            stats_.in_use++;
+            if (stats_.in_use > stats_.peak) stats_.peak = stats_.in_use;
+            lock_.unlock();
+            return slots_[first + bit];
+        }
+        stats_.heap_fallbacks++;
+        lock_.unlock();
+    } else {
+        lock_.lock();
+        stats_.heap_fallbacks++;
+        lock_.unlock();
+    }
+    return ::operator new(size);
+}
+
+void FramePool::deallocate(void* ptr, size_t /*size*/) {
+    uint8_t* p = static_cast<uint8_t*>(ptr);
+    uint8_t* base = &slots_[0][0];
+    if (p >= base && p < base + sizeof(slots_)) {
+        size_t slot = (p - base) / frame_pool_slot_size;
+        lock_.lock();
+        used_[slot / 32] &= ~(1UL << (slot % 32));
+        stats_.in_use--;
+        lock_.unlock();
+        return;
+    }
+    ::operator delete(ptr);
+}
+
+frame_pool_stats_t FramePool::get_stats() {
+    lock_.lock();
+    frame_pool_stats_t stats = stats_;
+    lock_.unlock();
+    return stats;
+}
+
+size_t FramePool::get_capacity() { return frame_pool_slots; }
+
+} // namespace hwp
+} // namespace esphome
@@ -0,0 +1,106 @@
+/**
+ * @file FramePool.h
+ * @brief Fixed-size object pool used to allocate the frames without touching the heap.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "SpinLock.h"
+
+namespace esphome {
+namespace hwp {
+
+static constexpr size_t frame_pool_slot_size = 192; ///< Room for a frame and its control block
+static constexpr size_t frame_pool_control_overhead = 32; ///< Reserved for the shared_ptr block
+
+/**
+ * @brief Usage statistics of the frame pool.
+ */
+typedef struct {
+    uint16_t in_use;         ///< Slots currently allocated
+    uint16_t peak;           ///< Highest number of slots allocated at once
+    uint32_t heap_fallbacks; ///< Allocations served by the heap because the pool was full
+} frame_pool_stats_t;
+
+/**
+ * @class FramePool
+ * @brief Static pool of fixed-size slots holding the frames and their shared_ptr control block.
+ *
+ * Frames are created and copied for every decoded packet and every command, and live as long
+ * as a long uptime. Serving them from a static pool keeps them from fragmenting the heap. If
+ * the pool runs out, the allocation falls back to the heap and is counted, so the pool can be
+ * sized from the statistics.
+ */
+class FramePool {
+  public:
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+    static frame_pool_stats_t get_stats();
+    /// @brief Number of slots, sized at build time (see FramePool.cpp).
+    static size_t get_capacity();
+
+  protected:
+    static Spinlock lock_;
+    static frame_pool_stats_t stats_;
+};
+
+/**
+ * @brief Standard allocator handing out FramePool slots, for use with std::allocate_shared.
+ */
+template <typename T> struct FramePoolAllocator {
+    using value_type = T;
+    FramePoolAllocator() = default;
+    template <typename U> FramePoolAllocator(const FramePoolAllocator<U>&) {}
+    T* allocate(size_t n) { return static_cast<T*>(FramePool::allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t n) { FramePool::deallocate(ptr, n * sizeof(T)); }
+    template <typename U> bool operator==(const FramePoolAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const FramePoolAllocator<U>&) const { return false; }
+};
+
+/**
+ * @brief Creates a frame in the pool, the pooled replacement of std::make_shared.
+ */
+template <typename T, typename... Args> std::shared_ptr<T> make_pooled_frame(Args&&... args) {
+    static_assert(sizeof(T) + frame_pool_control_overhead <= frame_pool_slot_size,
+        "Frame class too large for the frame pool slots");
+    return std::allocate_shared<T>(FramePoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+} // namespace hwp
+} // namespace esphome
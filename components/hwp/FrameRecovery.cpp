@@ -0,0 +1,183 @@
+/**
+ * @file FrameRecovery.cpp
+ * @brief Recovery of frame copies that failed the checksum.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "FrameRecovery.h"
+#include <algorithm>
+#include "FrameTypes.h"
+#include "HPUtils.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace hwp {
+
+static constexpr char TAG_RECOVERY[] = "hwp.recovery";
+
+bool FrameRecovery::is_checksum_valid(const hp_packetdata_t& packet) {
+    if (packet.is_checksum_valid()) return true;
+    hp_packetdata_t inverted = packet;
+    inverse(inverted.data, inverted.data_len);
+    return inverted.is_checksum_valid();
+}
+
+bool FrameRecovery::is_known_frame(const hp_packetdata_t& packet) {
+    BaseFrame frame;
+    frame.packet = packet;
+    if (!frame.packet.is_checksum_valid()) {
+        inverse(frame.packet.data, frame.packet.data_len);
+        if (!frame.packet.is_checksum_valid()) return false;
+    }
+    const auto& range = frame_types::ranges[frame.packet.get_type()];
+    for (size_t i = range.first; i < static_cast<size_t>(range.first) + range.count; i++) {
+        if (frame_types::classes[i].matches(frame, frame)) return true;
+    }
+    return false;
+}
+
+uint8_t FrameRecovery::distance_(const hp_packetdata_t& a, const hp_packetdata_t& b) {
+    uint8_t bits = 0;
+    for (size_t i = 0; i < a.data_len && i < sizeof(a.data); i++) {
+        bits += __builtin_popcount(a.data[i] ^ b.data[i]);
+    }
+    return bits;
+}
+
+void FrameRecovery::remove_(size_t index) {
+    for (size_t i = index; i + 1 < this->count_; i++) {
+        this->candidates_[i] = this->candidates_[i + 1];
+        this->received_ms_[i] = this->received_ms_[i + 1];
+    }
+    this->count_--;
+}
+
+bool FrameRecovery::add_candidate(
+    const hp_packetdata_t& packet, uint32_t now_ms, hp_packetdata_t& recovered) {
+    this->stats_.candidates++;
+    // keep only the copies that look like the same frame of the same burst
+    for (size_t i = this->count_; i-- > 0;) {
+        if (now_ms - this->received_ms_[i] > burst_vote_max_age_ms ||
+            this->candidates_[i].data_len != packet.data_len ||
+            distance_(this->candidates_[i], packet) > burst_vote_max_distance_bits) {
+            this->remove_(i);
+        }
+    }
+    if (this->count_ == burst_vote_candidates) this->remove_(0);
+    this->candidates_[this->count_] = packet;
+    this->received_ms_[this->count_] = now_ms;
+    this->count_++;
+
+    if (this->count_ < burst_vote_min_candidates) return false;
+    this->stats_.votes++;
+    if (!this->vote_(recovered)) {
+        ESP_LOGV(TAG_RECOVERY, "Majority of %u copies failed the checksum", this->count_);
+        return false;
+    }
+    this->stats_.recovered++;
+    ESP_LOGD(TAG_RECOVERY, "Frame 0x%02X recovered from %u damaged copies", recovered.get_type(),
+        this->count_);
+    this->count_ = 0;
+    return true;
+}
+
+bool FrameRecovery::vote_(hp_packetdata_t& voted) const {
+    // the newest copy breaks ties
+    const hp_packetdata_t& newest = this->candidates_[this->count_ - 1];
+    voted = newest;
+    for (size_t byte = 0; byte < newest.data_len && byte < sizeof(newest.data); byte++) {
+        uint8_t value = 0;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            uint8_t mask = 1 << bit;
+            size_t ones = 0;
+            for (size_t i = 0; i < this->count_; i++) {
+                if (this->candidates_[i].data[byte] & mask) ones++;
+            }
+            bool tie = ones * 2 == this->count_;
+            if (ones * 2 > this->count_ || (tie && (newest.data[byte] & mask))) {
+                value |= mask;
+            }
+        }
+        voted.data[byte] = value;
+    }
+    return is_checksum_valid(voted);
+}
+
+bool FrameRecovery::repair(
+    const hp_packetdata_t& packet, const uint16_t* bit_margins, hp_packetdata_t& repaired) {
+    this->stats_.repairs_attempted++;
+    // pick the bits received with the smallest timing margin
+    size_t weakest[repair_max_bits];
+    size_t weakest_count = 0;
+    size_t bits = std::min<size_t>(packet.data_len, sizeof(packet.data)) * 8;
+    for (size_t bit = 0; bit < bits; bit++) {
+        size_t pos = weakest_count;
+        while (pos > 0 && bit_margins[weakest[pos - 1]] > bit_margins[bit]) pos--;
+        if (pos >= repair_max_bits) continue;
+        if (weakest_count < repair_max_bits) weakest_count++;
+        for (size_t i = weakest_count - 1; i > pos; i--) weakest[i] = weakest[i - 1];
+        weakest[pos] = bit;
+    }
+
+    size_t valid_count = 0;
+    for (uint32_t flips = 1; flips < (1U << weakest_count); flips++) {
+        hp_packetdata_t candidate = packet;
+        for (size_t i = 0; i < weakest_count; i++) {
+            if (flips & (1U << i)) candidate.data[weakest[i] / 8] ^= 1 << (weakest[i] % 8);
+        }
+        if (is_known_frame(candidate)) {
+            repaired = candidate;
+            valid_count++;
+        }
+    }
+    if (valid_count != 1) {
+        // no solution, or several ones and no way to tell which is right
+        this->stats_.repairs_rejected++;
+        ESP_LOGV(TAG_RECOVERY, "Repair rejected, %u valid combination(s)", valid_count);
+        return false;
+    }
+    this->stats_.repairs_succeeded++;
+    ESP_LOGD(TAG_RECOVERY, "Frame 0x%02X repaired", repaired.get_type());
+    return true;
+}
+
+void FrameRecovery::on_valid_frame(const hp_packetdata_t& packet) {
+    for (size_t i = this->count_; i-- > 0;) {
+        if (this->candidates_[i].data_len == packet.data_len &&
+            distance_(this->candidates_[i], packet) <= burst_vote_max_distance_bits) {
+            this->remove_(i);
+        }
+    }
+}
+
+}  // namespace hwp
+}  // namespace esphome
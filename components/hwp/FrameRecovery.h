@@ -0,0 +1,127 @@
+/**
+ * @file FrameRecovery.h
+ * @brief Recovery of frame copies that failed the checksum.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Schema.h"
+
+namespace esphome {
+namespace hwp {
+
+static constexpr size_t burst_vote_candidates = 5;        ///< Failed copies kept for voting
+static constexpr size_t burst_vote_min_candidates = 3;    ///< Copies needed for a majority
+static constexpr uint32_t burst_vote_max_age_ms = 10 * 1000; ///< Older copies are another burst
+/// Copies further apart than this are considered to be different frames.
+static constexpr uint8_t burst_vote_max_distance_bits = 12;
+static constexpr size_t repair_max_bits = 3; ///< Least confident bits tried when repairing
+
+/**
+ * @brief Statistics of the frame recovery.
+ */
+typedef struct {
+    uint32_t candidates; ///< Copies with a valid size that failed the checksum
+    uint32_t votes;      ///< Majority votes computed
+    uint32_t recovered;  ///< Voted frames that passed the checksum
+    uint32_t repairs_attempted; ///< Copies handed to the bit repair
+    uint32_t repairs_succeeded; ///< Copies fixed by flipping their least confident bits
+    uint32_t repairs_rejected;  ///< No flip, or more than one, gave a valid known frame
+} frame_recovery_stats_t;
+
+/**
+ * @class FrameRecovery
+ * @brief Rebuilds frames from the copies of a burst that failed the checksum.
+ *
+ * Every frame is repeated several times in a burst. Copies that fail the checksum are kept
+ * (up to burst_vote_candidates); once enough copies of the same frame are available, each bit
+ * is voted by majority and the result is accepted if its checksum, normal or inverted,
+ * validates. Copies are grouped by length and bit distance, and forgotten once a copy of the
+ * same frame is received intact.
+ *
+ * Optionally, a single damaged copy can also be repaired: the bits whose pulse timings were
+ * the closest to the decision limits are flipped, alone or together, and the result is
+ * accepted if exactly one combination gives a valid checksum and a known frame type.
+ */
+class FrameRecovery {
+  public:
+    /**
+     * @brief Adds a copy that failed the checksum.
+     *
+     * @param packet The copy, as received (not inverted).
+     * @param now_ms Current time, used to forget copies from previous bursts.
+     * @param recovered Receives the voted frame, as received (not inverted).
+     * @return true If a frame was recovered.
+     */
+    bool add_candidate(const hp_packetdata_t& packet, uint32_t now_ms, hp_packetdata_t& recovered);
+    /**
+     * @brief Forgets the copies of a frame that was received intact.
+     */
+    void on_valid_frame(const hp_packetdata_t& packet);
+    /**
+     * @brief Tries to repair a copy by flipping its least confident bits.
+     *
+     * @param packet The copy, as received (not inverted).
+     * @param bit_margins Timing margin of each bit of the copy, see Decoder::get_bit_margins().
+     * @param repaired Receives the repaired frame, as received (not inverted).
+     * @return true If exactly one combination of flips gives a valid frame.
+     */
+    bool repair(
+        const hp_packetdata_t& packet, const uint16_t* bit_margins, hp_packetdata_t& repaired);
+    void set_repair_enabled(bool enabled) { this->repair_enabled_ = enabled; }
+    bool is_repair_enabled() const { return this->repair_enabled_; }
+    void clear() { this->count_ = 0; }
+    const frame_recovery_stats_t& get_stats() const { return this->stats_; }
+
+    /// @brief True if the checksum validates, as sent by the controller or by the heater.
+    static bool is_checksum_valid(const hp_packetdata_t& packet);
+    /// @brief True if the checksum validates and a known frame class matches the content.
+    static bool is_known_frame(const hp_packetdata_t& packet);
+
+  protected:
+    static uint8_t distance_(const hp_packetdata_t& a, const hp_packetdata_t& b);
+    bool vote_(hp_packetdata_t& voted) const;
+    void remove_(size_t index);
+
+    hp_packetdata_t candidates_[burst_vote_candidates]{};
+    uint32_t received_ms_[burst_vote_candidates]{};
+    size_t count_{0};
+    bool repair_enabled_{false};
+    frame_recovery_stats_t stats_{};
+};
+
+}  // namespace hwp
+}  // namespace esphome
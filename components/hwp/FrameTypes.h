@@ -0,0 +1,152 @@
+/**
+ * @file FrameTypes.h
+ * @brief Compile-time list of the known frame classes and their dispatch table.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "FrameClock.h"
+#include "FrameConditions1.h"
+#include "FrameConditions1B.h"
+#include "FrameConditions2.h"
+#include "FrameConditions2B.h"
+#include "FrameConditionsD.h"
+#include "FrameConf1.h"
+#include "FrameConf2.h"
+#include "FrameConf3.h"
+#include "FrameConf4.h"
+#include "FrameConf5.h"
+#include "FrameConf6.h"
+#include "base_frame.h"
+
+namespace esphome {
+namespace hwp {
+
+/// @brief A frame class, the packet type byte it decodes and the priority of its commands.
+template <typename FrameClass, uint8_t TypeByte, tx_priority_t Priority = TX_PRIORITY_NORMAL>
+struct FrameType {
+    using frame = FrameClass;
+    static constexpr uint8_t type = TypeByte;
+    static constexpr tx_priority_t tx_priority = Priority;
+};
+
+/// @brief Dispatch entry of a frame class, as stored in the constexpr table.
+typedef struct {
+    uint8_t type;
+    BaseFrame::FrameFactoryMethod factory;
+    BaseFrame::FrameMatchesMethod matches;
+    tx_priority_t tx_priority;
+} frame_class_t;
+
+/// @brief Range of the table entries sharing one packet type byte.
+typedef struct {
+    uint8_t first;
+    uint8_t count;
+} frame_type_range_t;
+
+/**
+ * @brief Type list of frame classes producing a constexpr dispatch table.
+ *
+ * The position in the list is the class type id. Classes sharing a type byte must be
+ * adjacent; the first one whose matcher accepts the frame wins, so within a type byte the
+ * list order is the matching priority.
+ */
+template <typename... Entries> struct FrameTypeList {
+    static constexpr size_t size = sizeof...(Entries);
+
+    static constexpr std::array<frame_class_t, size> classes{
+        {{Entries::type, &Entries::frame::create, &Entries::frame::matches,
+            Entries::tx_priority}...}};
+
+    template <typename T> static constexpr size_t index_of() {
+        constexpr bool same[] = {std::is_same<T, typename Entries::frame>::value...};
+        for (size_t i = 0; i < size; i++) {
+            if (same[i]) return i;
+        }
+        return size;
+    }
+
+    static constexpr std::array<frame_type_range_t, 256> build_ranges() {
+        std::array<frame_type_range_t, 256> ranges{};
+        for (size_t i = 0; i < size; i++) {
+            auto& range = ranges[classes[i].type];
+            if (range.count == 0) range.first = static_cast<uint8_t>(i);
+            range.count++;
+        }
+        return ranges;
+    }
+
+    /// @brief Table entries to try for each packet type byte.
+    static constexpr std::array<frame_type_range_t, 256> ranges = build_ranges();
+
+    static constexpr bool is_grouped() {
+        for (size_t i = 0; i < size; i++) {
+            const auto& range = ranges[classes[i].type];
+            if (i < range.first || i >= static_cast<size_t>(range.first) + range.count) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Commands of the mode/power/setpoint frame go out first, and the defrost eco/flow settings are
+// the first to go when the transmit queue overflows.
+// clang-format off
+using frame_types = FrameTypeList<
+    FrameType<FrameClock, FrameClock::FRAME_ID_CLOCK>,
+    // reserved_1 == 0x05 identifies the regular conditions, anything else is the B variant
+    FrameType<FrameConditions1, FrameConditions1::FRAME_ID_CONDITIONS_1>,
+    FrameType<FrameConditions1B, FrameConditions1::FRAME_ID_CONDITIONS_1>,
+    // told apart by the frame length
+    FrameType<FrameConditions2, FrameConditions2::FRAME_ID_CONDITIONS2>,
+    FrameType<FrameConditions2B, FrameConditions2::FRAME_ID_CONDITIONS2>,
+    FrameType<FrameConditionsD, FrameConditionsD::FRAME_ID_COND_D>,
+    FrameType<FrameConf1, FrameConf1::FRAME_ID_CONF_1, TX_PRIORITY_HIGH>,
+    FrameType<FrameConf2, FrameConf2::FRAME_ID_CONF_2>,
+    FrameType<FrameConf3, FrameConf3::FRAME_ID_CONF_3>,
+    FrameType<FrameConf4, FrameConf4::FRAME_ID_CONF_4>,
+    FrameType<FrameConf5, FrameConf5::FRAME_ID_CONF_5, TX_PRIORITY_LOW>,
+    FrameType<FrameConf6, FrameConf6::FRAME_ID_CONF_6>>;
+// clang-format on
+
+static_assert(frame_types::is_grouped(), "frame classes sharing a type byte must be adjacent");
+static_assert(frame_types::size < UINT8_MAX, "type ids are stored on 8 bits");
+
+}  // namespace hwp
+}  // namespace esphome
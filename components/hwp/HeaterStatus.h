@@ -33,8 +33,13 @@
 
 #pragma once
 
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <vector>
+
+#include "AllocTelemetry.h"
 
 namespace esphome {
 namespace hwp {
@@ -61,120 +66,120 @@ typedef enum {
 } ErrorStatuses;
 
 /**
- * @class ErrorEntry
  * @brief Represents an error entry with code, description, solution, and source.
+ *
+ * Entries only hold pointers to string literals, so the whole table lives in flash.
  */
-class ErrorEntry {
-  public:
-    // Default constructor
-    ErrorEntry()
-        : value_(0), code_("S99"), source_(ERROR_SOURCE_OPERATIONAL), status_(ERROR_STATUS_S99),
-          description_("Waiting For Data"), solution_("") {}
-
-    // Constructor with parameters
-    ErrorEntry(uint8_t value, std::string code, ErrorSources source, ErrorStatuses status,
-               std::string description, std::string solution)
-        : value_(value), code_(code), source_(source), status_(status), description_(description),
-          solution_(solution) {}
-
-    // Equality operator for comparison with uint8_t
-    bool operator==(const uint8_t value) const { return this->value_ == value; }
-
-    // Getters
-    const std::string &get_code() const { return this->code_; }
-    const std::string &get_description() const { return this->description_; }
-    const std::string &get_solution() const { return this->solution_; }
-    ErrorSources get_source() const { return this->source_; }
-    ErrorStatuses get_status() const { return this->status_; }
-
-    // To-String Method
-    std::string to_string() const {
-        return "Code: " + this->code_ + "\nDescription: " + this->description_ +
-               "\nSolution: " + this->solution_ + "\nSource: " +
-               (this->source_ == ERROR_SOURCE_HARDWARE ? "Hardware Issue" : "Operational Problem");
-    }
-
-  protected:
-    uint8_t value_;
-    std::string code_;
-    ErrorSources source_;
-    ErrorStatuses status_;
-    std::string description_;
-    std::string solution_;
-};
-
-// Vector containing all error codes
-const std::vector<ErrorEntry> error_codes_ = {
-    {0, "S00", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_S00, "Operational", ""},
-    {1, "P01", ERROR_SOURCE_HARDWARE, ERROR_STATUS_P01, "Water inlet sensor malfunction",
+typedef struct {
+    uint8_t value;
+    ErrorSources source;
+    ErrorStatuses status;
+    const char *code;
+    const char *description;
+    const char *solution;
+} ErrorEntry;
+
+// Table of all the known error codes. The first two entries are the "no data yet" and the
+// "no error" states.
+constexpr std::array<ErrorEntry, 14> error_codes_ = {{
+    {0, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_S99, "S99", "Waiting For Data", ""},
+    {0, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_S00, "S00", "Operational", ""},
+    {1, ERROR_SOURCE_HARDWARE, ERROR_STATUS_P01, "P01", "Water inlet sensor malfunction",
         "Check or replace the sensor."},
-    {2, "P02", ERROR_SOURCE_HARDWARE, ERROR_STATUS_P02, "Water outlet sensor malfunction",
+    {2, ERROR_SOURCE_HARDWARE, ERROR_STATUS_P02, "P02", "Water outlet sensor malfunction",
         "Check or replace the sensor."},
-    {5, "P05", ERROR_SOURCE_HARDWARE, ERROR_STATUS_P05, "Defrost sensor malfunction",
+    {5, ERROR_SOURCE_HARDWARE, ERROR_STATUS_P05, "P05", "Defrost sensor malfunction",
         "Check or replace the sensor."},
-    {4, "P04", ERROR_SOURCE_HARDWARE, ERROR_STATUS_P04, "Outside temperature sensor malfunction",
+    {4, ERROR_SOURCE_HARDWARE, ERROR_STATUS_P04, "P04", "Outside temperature sensor malfunction",
         "Check or replace the sensor."},
-    {6, "E06", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E06,
+    {6, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E06, "E06",
         "Large temperature difference between inlet and outlet water",
         "Check the water flow or system obstruction."},
-    {7, "E07", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E07, "Antifreeze protection in cooling mode",
+    {7, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E07, "E07", "Antifreeze protection in cooling mode",
         "Check the water flow or outlet water temperature sensor."},
-    {19, "E19", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E19, "Level 1 antifreeze protection",
+    {19, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E19, "E19", "Level 1 antifreeze protection",
         "Ambient or inlet water temperature is too low."},
-    {29, "E29", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E29, "Level 2 antifreeze protection",
+    {29, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E29, "E29", "Level 2 antifreeze protection",
         "Ambient or inlet water temperature is even lower."},
-    {1, "E01", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E01, "High pressure protection",
+    {1, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E01, "E01", "High pressure protection",
         "Check the high pressure switch and refrigerant circuit pressure.\nCheck the water or air "
         "flow.\nEnsure the flow controller is working properly.\nCheck the inlet/outlet water "
         "valves.\nCheck the bypass setting."},
-    {2, "E02", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E02, "Low pressure protection",
+    {2, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E02, "E02", "Low pressure protection",
         "Check the low pressure switch and refrigerant circuit pressure for leaks.\nClean the "
         "evaporator surface.\nCheck the fan speed.\nEnsure air can circulate freely through the "
         "evaporator."},
-    {3, "E03", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E03, "Flow detector malfunction",
+    {3, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_E03, "E03", "Flow detector malfunction",
         "Check the water flow.\nCheck the filtration pump and flow detector for faults."},
-    {8, "EE8", ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_EE8, "Communication problem",
-        "Check the cable connections."}};
+    {8, ERROR_SOURCE_OPERATIONAL, ERROR_STATUS_EE8, "EE8", "Communication problem",
+        "Check the cable connections."},
+}};
+
+static constexpr uint8_t error_index_waiting = 0;
+static constexpr uint8_t error_index_operational = 1;
+
+/**
+ * @brief Position of a (source, raw value) pair in the 256 entries lookup index.
+ *
+ * Raw values are below 128, so the source takes the high bit.
+ */
+constexpr size_t error_index_key(ErrorSources source, uint8_t value) {
+    return (source == ERROR_SOURCE_HARDWARE ? 0x80 : 0x00) | (value & 0x7F);
+}
+
+constexpr std::array<uint8_t, 256> build_error_index() {
+    std::array<uint8_t, 256> index{};
+    for (size_t i = 0; i < index.size(); i++) {
+        index[i] = error_index_operational; // unknown codes report as operational
+    }
+    for (size_t i = error_index_operational + 1; i < error_codes_.size(); i++) {
+        index[error_index_key(error_codes_[i].source, error_codes_[i].value)] =
+            static_cast<uint8_t>(i);
+    }
+    return index;
+}
+
+// Maps a (source, raw value) key to its position in error_codes_
+constexpr std::array<uint8_t, 256> error_index_ = build_error_index();
+static_assert(error_index_[error_index_key(ERROR_SOURCE_HARDWARE, 1)] == 2, "P01 lookup");
+static_assert(error_index_[error_index_key(ERROR_SOURCE_OPERATIONAL, 1)] == 10, "E01 lookup");
 
 /**
  * @class HeaterStatus
  * @brief Manages the heater status by matching error codes to descriptions and solutions.
+ *
+ * Only the position of the entry in error_codes_ is kept, so comparing two statuses is a
+ * single byte comparison.
  */
 class HeaterStatus {
   public:
-    // Default constructor
-    HeaterStatus() : error_entry_(error_codes_[0]) {}
+    HeaterStatus() = default;
 
-    // Constructor with error code
-    HeaterStatus(uint8_t value) { find_error_entry(value); }
-
-    // Method to update the current error entry based on the error code
-    void update(uint8_t value) { find_error_entry(value); }
+    // Method to update the current error entry based on the error source and raw code
+    void update(ErrorSources source, uint8_t value) {
+        this->index_ = error_index_[error_index_key(source, value)];
+    }
 
     // Getters
-    const std::string &get_code() const { return this->error_entry_.get_code(); }
-    const std::string &get_description() const { return this->error_entry_.get_description(); }
-    const std::string &get_solution() const { return this->error_entry_.get_solution(); }
-    ErrorSources get_source() const { return this->error_entry_.get_source(); }
-    ErrorStatuses get_status() const { return this->error_entry_.get_status(); }
+    uint8_t get_index() const { return this->index_; }
+    const ErrorEntry &get_entry() const { return error_codes_[this->index_]; }
+    const char *get_code() const { return this->get_entry().code; }
+    const char *get_description() const { return this->get_entry().description; }
+    const char *get_solution() const { return this->get_entry().solution; }
+    ErrorSources get_source() const { return this->get_entry().source; }
+    ErrorStatuses get_status() const { return this->get_entry().status; }
 
     // To-String Method
-    std::string to_string() const { return this->error_entry_.to_string(); }
+    std::string to_string() const {
+        HWP_ALLOC_SCOPE(ALLOC_SITE_HEATER_STATUS);
+        const ErrorEntry &entry = this->get_entry();
+        return std::string("Code: ") + entry.code + "\nDescription: " + entry.description +
+               "\nSolution: " + entry.solution + "\nSource: " +
+               (entry.source == ERROR_SOURCE_HARDWARE ? "Hardware Issue" : "Operational Problem");
+    }
 
   protected:
-    ErrorEntry error_entry_;
-
-    // Method to find and set the error entry based on the error code
-    void find_error_entry(uint8_t value) {
-        for (const auto &entry : error_codes_) {
-            if (entry == value) {
-                this->error_entry_ = entry;
-                return;
-            }
-        }
-        // Default to "Operational" if code not found
-        this->error_entry_ = error_codes_[0];
-    }
+    uint8_t index_{error_index_waiting};
 };
 
 }  // namespace hwp
@@ -31,6 +31,7 @@
  * for any damage or loss caused by the use of this software.
  */
 #include "PoolHeater.h"
+#include "FrameConf1.h"
 
 #include "Schema.h"
 #include "base_frame.h"
@@ -51,21 +52,193 @@ PoolHeater::PoolHeater(InternalGPIOPin* gpio_pin) { this->driver_.set_gpio_pin(g
 void PoolHeater::setup() {
     ESP_LOGI(POOL_HEATER_TAG, "Restoring state");
     restore_state_();
-    ESP_LOGI(POOL_HEATER_TAG, "Setting up driver");
-    this->driver_.setup();
+    AllocTelemetry::register_task(ALLOC_CONTEXT_MAIN, xTaskGetCurrentTaskHandle());
     this->driver_.set_data_model(hp_data_);
     this->current_temperature = NAN;
 
-    // Seed preferences with build timestamp so state refreshes after firmware updates.
+    // The key is stable across builds so the state survives firmware updates; the version
+    // field of the preferences guards against layout changes.
     preferences_ = global_preferences->make_preference<PoolHeaterPreferences>(
-        get_object_id_hash() ^ fnv1_hash(__DATE__ " " __TIME__));
+        get_object_id_hash() ^ fnv1_hash("hwp_preferences"));
+    // Replay the saved frames before the bus starts decoding, they share the same registry
     restore_preferences_();
+    ESP_LOGI(POOL_HEATER_TAG, "Setting up driver");
+    this->driver_.setup();
+    // The fault history must survive firmware updates, so its key does not include the build
+    this->fault_log_.setup(get_object_id_hash() ^ fnv1_hash("hwp_fault_log"));
+    // A fault still active at reboot must not be logged twice
+    this->logged_status_index_ = this->fault_log_.get_last_status();
+#ifdef USE_API
+    register_service(&PoolHeater::on_fault_log_service_, "hwp_fault_log");
+    register_service(&PoolHeater::on_clear_fault_log_service_, "hwp_clear_fault_log");
+#endif
     set_actual_status("Ready");
     this->status_set_warning("Waiting for heater state");
     ESP_LOGI(POOL_HEATER_TAG, "Setup complete");
 }
 
 
+void PoolHeater::loop() {
+#ifdef USE_HWP_DEFERRED_LOGGING
+    BaseFrame::flush_deferred_prints();
+#endif
+    command_result_t result;
+    while (this->driver_.get_command_tracker().take_result(&result, millis())) {
+        if (result.outcome == COMMAND_CONFIRMED) {
+            ESP_LOGD(POOL_HEATER_TAG, "Command #%u confirmed by the heater after %ums",
+                result.ticket, result.elapsed_ms);
+            this->command_confirmed_callback_.call(
+                result.ticket, result.elapsed_ms, result.frame_type);
+        } else {
+            const char* reason = CommandTracker::outcome_to_string(result.outcome);
+            ESP_LOGW(POOL_HEATER_TAG, "Command #%u failed after %ums: %s (frame type 0x%02X)",
+                result.ticket, result.elapsed_ms, reason, result.frame_type);
+            this->command_failed_callback_.call(
+                result.ticket, std::string(reason), result.frame_type);
+        }
+    }
+    if (!this->state_confirmed_ms_.has_value()) {
+        // the state is shown from the last FrameConf1, restored or received, but commands
+        // wait for a received one
+        auto conf = this->driver_.get_registry().get<FrameConf1>();
+        if (!this->state_valid_ms_.has_value() && conf && conf->is_valid()) {
+            this->state_valid_ms_ = millis();
+            ESP_LOGI(POOL_HEATER_TAG, "Heater state known after %ums%s",
+                this->state_valid_ms_.value(), conf->is_restored() ? " (restored)" : "");
+        }
+        if (this->state_valid_ms_.has_value() &&
+            this->driver_.get_registry().restored_count() == 0) {
+            this->state_confirmed_ms_ = millis();
+            ESP_LOGI(POOL_HEATER_TAG, "Heater state confirmed by the bus after %ums",
+                this->state_confirmed_ms_.value());
+        }
+    }
+}
+
+void PoolHeater::on_shutdown() {
+    this->fault_log_.flush(millis(), true);
+    this->save_preferences_(true);
+}
+
+void PoolHeater::collect_preferences_(PoolHeaterPreferences& prefs) {
+    // zero the padding too, the structure is compared with memcmp
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.version = preferences_version;
+    prefs.target_temperature = this->hp_data_.target_temperature.value_or(NAN);
+    prefs.mode = this->hp_data_.mode.has_value() ? static_cast<uint8_t>(this->hp_data_.mode.value())
+                                                 : UINT8_MAX;
+    // Known classes sit at their class type id in the registry, so each gets its own slot. The
+    // frames are replayed through the matchers on restore, the slot is only used for compares.
+    auto& registry = this->driver_.get_registry();
+    for (size_t i = 0; i < persisted_frames_count; i++) {
+        prefs.frame_sources[i] = SOURCE_UNKNOWN;
+        const auto& frame = registry[i].instance;
+        if (frame->is_valid() && frame->is_size_valid()) {
+            prefs.frame_sources[i] = frame->get_source();
+            prefs.frames[i] = frame->packet;
+        }
+    }
+    for (size_t i = 0; i < BURST_ORIGIN_COUNT; i++) {
+        prefs.timings[i] = this->driver_.get_scheduler().timing(static_cast<burst_origin_t>(i));
+    }
+}
+
+void PoolHeater::restore_preferences_() {
+    PoolHeaterPreferences prefs;
+    if (!this->preferences_.load(&prefs) || prefs.version != preferences_version) {
+        ESP_LOGCONFIG(POOL_HEATER_TAG, "No saved state to restore");
+        return;
+    }
+    this->saved_preferences_ = prefs;
+    size_t frames = 0;
+    for (size_t i = 0; i < persisted_frames_count; i++) {
+        if (prefs.frame_sources[i] == SOURCE_HEATER ||
+            prefs.frame_sources[i] == SOURCE_CONTROLLER) {
+            this->driver_.replay_frame(
+                prefs.frames[i], static_cast<frame_source_t>(prefs.frame_sources[i]));
+            frames++;
+        }
+    }
+    // The frames carry the setpoints too, but only if they were received before the save
+    if (!this->hp_data_.target_temperature.has_value() && !std::isnan(prefs.target_temperature)) {
+        this->hp_data_.target_temperature = prefs.target_temperature;
+    }
+    if (!this->hp_data_.mode.has_value() && prefs.mode != UINT8_MAX) {
+        this->hp_data_.mode = static_cast<climate::ClimateMode>(prefs.mode);
+    }
+    for (size_t i = 0; i < BURST_ORIGIN_COUNT; i++) {
+        this->driver_.restore_timing(static_cast<burst_origin_t>(i), prefs.timings[i]);
+    }
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "Restored saved state (%u frames, stale until received)",
+        frames);
+}
+
+bool PoolHeater::is_settings_change_(const PoolHeaterPreferences& prefs) const {
+    const PoolHeaterPreferences& saved = this->saved_preferences_;
+    if (memcmp(&prefs.target_temperature, &saved.target_temperature,
+            sizeof(prefs.target_temperature)) != 0 ||
+        prefs.mode != saved.mode) {
+        return true;
+    }
+    // The source is left out: the controller commands and the heater echoes carry the same data
+    for (size_t i = first_settings_class; i <= last_settings_class; i++) {
+        bool present = prefs.frame_sources[i] != SOURCE_UNKNOWN;
+        if (present != (saved.frame_sources[i] != SOURCE_UNKNOWN)) return true;
+        if (present && memcmp(&prefs.frames[i], &saved.frames[i], sizeof(prefs.frames[i])) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PoolHeater::save_preferences_(bool force) {
+    PoolHeaterPreferences prefs;
+    this->collect_preferences_(prefs);
+    // The clock, the conditions and the bus timings change all the time: they are only
+    // refreshed along with a settings change, or on shutdown, to spare the flash.
+    if (!force && !this->is_settings_change_(prefs)) return;
+    if (memcmp(&prefs, &this->saved_preferences_, sizeof(prefs)) == 0) return;
+    uint32_t now = millis();
+    if (!force && this->preferences_writes_ > 0 &&
+        now - this->last_preferences_save_ms_ < this->preferences_save_interval_ms_) {
+        // changes keep accumulating until the interval elapsed
+        return;
+    }
+    if (this->preferences_.save(&prefs)) {
+        this->saved_preferences_ = prefs;
+        this->last_preferences_save_ms_ = now;
+        this->preferences_writes_++;
+        ESP_LOGD(POOL_HEATER_TAG, "State saved");
+    }
+}
+
+#ifdef USE_API
+void PoolHeater::on_fault_log_service_() {
+    ESP_LOGI(POOL_HEATER_TAG, "Fault log (%u events, most recent first):", this->fault_log_.size());
+    for (size_t i = 0; i < this->fault_log_.size(); i++) {
+        const fault_event_t& event = this->fault_log_.get(i);
+        ESP_LOGI(POOL_HEATER_TAG, "  %s", this->fault_log_.format(event).c_str());
+        const ErrorEntry& entry = FaultLog::get_entry(event);
+        auto temperature = [](int16_t value) {
+            return value == fault_temperature_unknown ? std::string()
+                                                      : value_accuracy_to_string(value / 10.0f, 1);
+        };
+        fire_homeassistant_event("esphome.hwp_fault_log",
+            {{"index", std::to_string(i)}, {"timestamp", std::to_string(event.timestamp)},
+                {"heater_time", (event.flags & FAULT_EVENT_HEATER_TIME) ? "true" : "false"},
+                {"code", entry.code}, {"description", entry.description},
+                {"inlet", temperature(event.inlet_x10)},
+                {"outlet", temperature(event.outlet_x10)},
+                {"coil", temperature(event.coil_x10)},
+                {"ambient", temperature(event.ambient_x10)}});
+    }
+}
+void PoolHeater::on_clear_fault_log_service_() {
+    ESP_LOGI(POOL_HEATER_TAG, "Clearing the fault log");
+    this->fault_log_.clear();
+}
+#endif
+
 void PoolHeater::set_actual_status_sensor(text_sensor::TextSensor* sensor) {
     this->actual_status_sensor_ = sensor;
 }
@@ -199,12 +372,35 @@ void PoolHeater::update() {
     //////////////////////////////////////////////
     ESP_LOGVV(POOL_HEATER_TAG, "Setting actual status");
     publish_sensor_value(this->actual_status_, this->actual_status_sensor_);
-    ESP_LOGVV(POOL_HEATER_TAG, "Setting heater status code");
-    publish_sensor_value(this->heater_status_.get_code(), this->heater_status_code_sensor_);
-    ESP_LOGVV(POOL_HEATER_TAG, "Setting heater status description");
-    publish_sensor_value(
-        this->heater_status_.get_description(), this->heater_status_description_sensor_);
-    publish_sensor_value(this->heater_status_.get_solution(), this->heater_status_solution_sensor_);
+    if (this->hp_data_.heater_error.has_value()) {
+        uint8_t error = this->hp_data_.heater_error.value();
+        this->heater_status_.update(
+            (error & 0x80) ? ERROR_SOURCE_HARDWARE : ERROR_SOURCE_OPERATIONAL, error & 0x7F);
+    } else if (!this->is_heater_offline()) {
+        // the heater talks but no error field is decoded: report it as operational
+        this->heater_status_.update(ERROR_SOURCE_OPERATIONAL, 0);
+    }
+    uint8_t status_index = this->heater_status_.get_index();
+    if (status_index != error_index_waiting && status_index != this->logged_status_index_) {
+        // only entering, leaving or changing a fault is worth a log entry
+        if (status_index > error_index_operational ||
+            this->logged_status_index_ > error_index_operational) {
+            this->fault_log_.record(status_index, this->hp_data_, millis());
+        }
+        this->logged_status_index_ = status_index;
+    }
+    this->fault_log_.flush(millis());
+    if (this->update_active_ &&
+        this->heater_status_.get_index() != this->published_status_index_) {
+        ESP_LOGVV(POOL_HEATER_TAG, "Setting heater status code");
+        publish_sensor_value(this->heater_status_.get_code(), this->heater_status_code_sensor_);
+        ESP_LOGVV(POOL_HEATER_TAG, "Setting heater status description");
+        publish_sensor_value(
+            this->heater_status_.get_description(), this->heater_status_description_sensor_);
+        publish_sensor_value(
+            this->heater_status_.get_solution(), this->heater_status_solution_sensor_);
+        this->published_status_index_ = this->heater_status_.get_index();
+    }
     
 
     //////////////////////////////////////////////    
@@ -221,7 +417,68 @@ void PoolHeater::update() {
     publish_sensor_value(this->hp_data_.mode_restrictions, this->h02_mode_restrictions_);    
      ESP_LOGVV(POOL_HEATER_TAG, "Setting flow meter");
     publish_sensor_value(this->hp_data_.U01_flow_meter, this->u01_flow_meter_);
-    
+
+    //////////////////////////////////////////////
+    // Transfer data to diagnostic sensors      //
+    //////////////////////////////////////////////
+    ESP_LOGVV(POOL_HEATER_TAG, "Setting TX arm time");
+    publish_sensor_value(this->driver_.get_tx_arm_time_ms(), this->tx_arm_time_);
+    ESP_LOGVV(POOL_HEATER_TAG, "Setting TX queue statistics");
+    publish_sensor_value(this->driver_.get_tx_queue_stats().merged, this->tx_merged_commands_);
+    publish_sensor_value(this->driver_.get_tx_queue_stats().dropped, this->tx_dropped_commands_);
+    publish_sensor_value(this->driver_.get_tx_queue_stats().expired, this->tx_expired_commands_);
+    if (this->driver_.get_tx_queue_stats().sent > 0) {
+        publish_sensor_value(
+            this->driver_.get_tx_queue_stats().avg_wait_ms, this->tx_queue_wait_time_);
+    }
+    publish_sensor_value(this->driver_.get_tx_queue_depth(), this->tx_queue_depth_);
+    if (this->driver_.get_tx_confirm_stats().commands > 0) {
+        const auto& confirm_stats = this->driver_.get_tx_confirm_stats();
+        publish_sensor_value(confirm_stats.repeats_per_command(), this->tx_repeats_per_command_);
+        if (confirm_stats.confirmed > 0) {
+            publish_sensor_value(confirm_stats.avg_latency_ms, this->tx_confirm_latency_);
+        }
+    }
+    publish_sensor_value(this->driver_.get_tx_collision_stats().collisions, this->tx_collisions_);
+    publish_sensor_value(this->driver_.get_tx_collision_stats().retries, this->tx_retries_);
+    publish_sensor_value(
+        this->driver_.get_scheduler().get_utilization(millis()), this->bus_utilization_);
+    ESP_LOGVV(POOL_HEATER_TAG, "Setting task stack high-water marks");
+    publish_sensor_value(DecodeWorker::get_stack_free(), this->rx_stack_free_);
+    const auto rx_capture_stats = this->driver_.get_rx_capture_stats();
+    publish_sensor_value(rx_capture_stats.dropped_edges, this->rx_dropped_edges_);
+    publish_sensor_value(rx_capture_stats.high_water_bytes, this->rx_ring_high_water_);
+    publish_sensor_value(
+        this->driver_.get_frame_recovery_stats().recovered, this->rx_recovered_frames_);
+    if (this->driver_.get_frame_end_stats().count > 0) {
+        publish_sensor_value(
+            this->driver_.get_frame_end_stats().avg_us, this->frame_end_latency_);
+    }
+    if (this->driver_.get_tx_timing_stats().samples > 0) {
+        publish_sensor_value(
+            this->driver_.get_tx_timing_stats().avg_error_us, this->tx_timing_error_);
+    }
+    if (this->driver_.get_rx_lag_stats().samples > 0) {
+        publish_sensor_value(this->driver_.get_rx_lag_stats().avg_us, this->rx_processing_lag_);
+    }
+    if (this->isr_max_time_ != nullptr) {
+        float cycles_per_us = arch_get_cpu_freq_hz() / 1000000.0f;
+        publish_sensor_value(
+            this->driver_.get_isr_timing_stats().max_cycles / cycles_per_us, this->isr_max_time_);
+    }
+    publish_sensor_value(FramePool::get_stats().heap_fallbacks, this->frame_pool_heap_fallbacks_);
+    publish_sensor_value(this->state_valid_ms_, this->state_valid_time_);
+    publish_sensor_value(this->state_confirmed_ms_, this->state_confirmed_time_);
+    ESP_LOGVV(POOL_HEATER_TAG, "Setting heap and allocation telemetry");
+    const auto heap = AllocTelemetry::get_heap();
+    publish_sensor_value(heap.min_free_bytes, this->heap_min_free_);
+    publish_sensor_value(heap.largest_free_block, this->heap_largest_free_block_);
+    if (AllocTelemetry::is_enabled()) {
+        publish_sensor_value(
+            AllocTelemetry::get_context(ALLOC_CONTEXT_MAIN).bytes, this->alloc_main_bytes_);
+        publish_sensor_value(
+            AllocTelemetry::get_context(ALLOC_CONTEXT_RX).bytes, this->alloc_rx_bytes_);
+    }
 
 
     //////////////////////////////////////////////
@@ -229,9 +486,9 @@ void PoolHeater::update() {
     //////////////////////////////////////////////
     if (this->update_active_) {
         ESP_LOGD(POOL_HEATER_TAG, "Publishing climate state");
-        save_preferences_();     
         climate::Climate::publish_state();
     }
+    save_preferences_();
 }
 
 
@@ -245,18 +502,141 @@ void PoolHeater::dump_config() {
     }
     ESP_LOGCONFIG(POOL_HEATER_TAG, "      - passive_mode: %s", ONOFF(this->passive_mode_));
     ESP_LOGCONFIG(POOL_HEATER_TAG, "      - update_active: %s", ONOFF(this->update_active_));
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - tx_ready_idle_window: %ums",
+        this->driver_.get_tx_ready_idle_window());
+    if (this->driver_.is_tx_armed()) {
+        ESP_LOGCONFIG(POOL_HEATER_TAG, "      - tx armed after: %ums",
+            this->driver_.get_tx_arm_time_ms().value());
+    } else {
+        ESP_LOGCONFIG(POOL_HEATER_TAG, "      - tx armed: NO");
+    }
+    const auto& tx_stats = this->driver_.get_tx_queue_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - tx queue: %u queued, %u merged, %u dropped, %u expired, %u sent in %u bursts",
+        tx_stats.enqueued, tx_stats.merged, tx_stats.dropped, tx_stats.expired, tx_stats.sent,
+        tx_stats.bursts);
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - tx queue wait: %ums avg, %ums max, %u pending, expiry %us",
+        tx_stats.avg_wait_ms, tx_stats.max_wait_ms, this->driver_.get_tx_queue_depth(),
+        this->driver_.get_tx_command_expiry() / 1000);
+    const auto& command_stats = this->driver_.get_command_tracker().get_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - commands: %u issued, %u confirmed, %u failed, %u pending, timeout %us",
+        command_stats.issued, command_stats.confirmed, command_stats.failed,
+        this->driver_.get_command_tracker().get_pending_count(),
+        this->driver_.get_command_tracker().get_timeout() / 1000);
+    const auto& scheduler = this->driver_.get_scheduler();
+    uint32_t now = millis();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - bus usage: %.1f%% (heater %.1f%%, controller %.1f%%, us %.1f%%) over %us",
+        scheduler.get_utilization(now), scheduler.get_utilization(BURST_HEATER, now),
+        scheduler.get_utilization(BURST_CONTROLLER, now),
+        scheduler.get_utilization(BURST_LOCAL, now),
+        (now - scheduler.get_usage().since_ms) / 1000);
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - adaptive repeats: %s",
+        ONOFF(this->driver_.get_adaptive_repeats()));
+    if (this->driver_.get_adaptive_repeats()) {
+        const auto& confirm_stats = this->driver_.get_tx_confirm_stats();
+        ESP_LOGCONFIG(POOL_HEATER_TAG,
+            "      - confirmed: %u/%u, %.2f repeats/command, avg latency %ums",
+            confirm_stats.confirmed, confirm_stats.commands, confirm_stats.repeats_per_command(),
+            confirm_stats.avg_latency_ms);
+    }
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - collision detect: %s",
+        ONOFF(this->driver_.get_collision_detect()));
+    if (this->driver_.get_collision_detect()) {
+        const auto& collision_stats = this->driver_.get_tx_collision_stats();
+        ESP_LOGCONFIG(POOL_HEATER_TAG,
+            "      - collisions: %u (%.1f%% of bursts), retries: %u, abandoned: %u",
+            collision_stats.collisions,
+            tx_stats.bursts == 0 ? 0.0f : 100.0f * collision_stats.collisions / tx_stats.bursts,
+            collision_stats.retries, collision_stats.abandoned);
+    }
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - bus task stack: %u bytes (default %u), %u never used",
+        DecodeWorker::get_stack_size(), DecodeWorker::default_stack_size,
+        DecodeWorker::get_stack_free().value_or(0));
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - bus task: core %d, priority %u, %u bus(es)",
+        DecodeWorker::get_task_core(), DecodeWorker::get_task_priority(),
+        DecodeWorker::get_bus_count());
+    const auto& tx_timing_stats = this->driver_.get_tx_timing_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - tx timing: %u levels, error %uus (avg), %uus (max), %u out of tolerance",
+        tx_timing_stats.samples, tx_timing_stats.avg_error_us, tx_timing_stats.max_error_us,
+        tx_timing_stats.out_of_tolerance);
+    const auto& rx_lag_stats = this->driver_.get_rx_lag_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - rx processing lag: %uus (avg), %uus (max)",
+        rx_lag_stats.avg_us, rx_lag_stats.max_us);
+    const auto rx_capture_stats = this->driver_.get_rx_capture_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - rx ring: %u edges, %u dropped, %u frames lost, peak %u/%u bytes",
+        rx_capture_stats.edges, rx_capture_stats.dropped_edges, rx_capture_stats.overruns,
+        rx_capture_stats.high_water_bytes, rx_ring_size);
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - glitches: %u merged, %u kept as erasures",
+        rx_capture_stats.glitches_merged, rx_capture_stats.erasures);
+    const auto& frame_end_stats = this->driver_.get_frame_end_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - frame end: %u frames finalized %uus (avg), %uus (max) after %ums idle",
+        frame_end_stats.count, frame_end_stats.avg_us, frame_end_stats.max_us,
+        frame_end_threshold_ms);
+    const auto& recovery_stats = this->driver_.get_frame_recovery_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - damaged copies: %u, majority votes: %u, frames recovered: %u",
+        recovery_stats.candidates, recovery_stats.votes, recovery_stats.recovered);
+    ESP_LOGCONFIG(
+        POOL_HEATER_TAG, "      - frame repair: %s", ONOFF(this->driver_.get_frame_repair()));
+    if (this->driver_.get_frame_repair()) {
+        ESP_LOGCONFIG(POOL_HEATER_TAG, "      - repairs: %u attempted, %u succeeded, %u rejected",
+            recovery_stats.repairs_attempted, recovery_stats.repairs_succeeded,
+            recovery_stats.repairs_rejected);
+    }
+    const auto isr_stats = this->driver_.get_isr_timing_stats();
+    std::string histogram;
+    for (size_t i = 0; i < isr_histogram_buckets; i++) {
+        histogram += (i == 0 ? "" : "/") + std::to_string(isr_stats.buckets[i]);
+    }
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - edge isr: %u calls, max %u cycles at %u MHz, by 512<<n cycles: %s",
+        isr_stats.count, isr_stats.max_cycles, arch_get_cpu_freq_hz() / 1000000,
+        histogram.c_str());
+    const auto pool_stats = FramePool::get_stats();
+    ESP_LOGCONFIG(POOL_HEATER_TAG,
+        "      - frame pool: %u/%u slots in use, peak %u, %u heap fallbacks", pool_stats.in_use,
+        FramePool::get_capacity(), pool_stats.peak, pool_stats.heap_fallbacks);
+    AllocTelemetry::log_report(POOL_HEATER_TAG);
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - saved state: %u write(s), at most every %us",
+        this->preferences_writes_, this->preferences_save_interval_ms_ / 1000);
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - state known after %ums, confirmed after %ums",
+        this->state_valid_ms_.value_or(0), this->state_confirmed_ms_.value_or(0));
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - fault log: %u event(s), %u pending, %u flash writes",
+        this->fault_log_.size(), this->fault_log_.get_pending(),
+        this->fault_log_.get_flash_writes());
+#ifdef USE_HWP_DEFERRED_LOGGING
+    ESP_LOGCONFIG(POOL_HEATER_TAG, "      - deferred logging: ON (%u frames dropped)",
+        BaseFrame::get_deferred_prints_dropped());
+#endif
     dump_traits_(POOL_HEATER_TAG);
     this->driver_.dump_known_packets(POOL_HEATER_TAG);
 }
-void PoolHeater::control(const HWPCall& hwpcall) {
+command_ticket_t PoolHeater::control(const HWPCall& hwpcall) {
+    this->last_command_ticket_ = no_command_ticket;
     auto ctrl_frames = this->driver_.control(hwpcall);
     if (this->passive_mode_) {
         ESP_LOGW(POOL_HEATER_TAG, "Passive mode. Ignoring inbound changes");
         this->status_momentary_warning("Passive mode. Ignoring changes", 5000);
         this->publish_state();
-        return;
+        return no_command_ticket;
+    }
+    if (ctrl_frames.empty() && this->driver_.get_registry().restored_count() > 0) {
+        ESP_LOGW(POOL_HEATER_TAG, "Heater state not received yet. Ignoring changes");
+        this->status_momentary_warning("Waiting for heater state. Ignoring changes", 5000);
+        // show the restored state again instead of the rejected change
+        this->publish_state();
+        return no_command_ticket;
     }
 
+    // track before queuing: the queue reports the frames it drops right away
+    command_ticket_t ticket = this->driver_.track_command(ctrl_frames);
+    this->last_command_ticket_ = ticket;
     bool success = true;
     for (size_t i = 0; i < ctrl_frames.size(); i++) {
         ctrl_frames[i]->print("QUEUE", POOL_HEATER_TAG, ESPHOME_LOG_LEVEL_VERBOSE, __LINE__);
@@ -269,6 +649,10 @@ void PoolHeater::control(const HWPCall& hwpcall) {
         this->status_momentary_error("Control queuing error");
         this->publish_state();
     }
+    if (ticket != no_command_ticket) {
+        ESP_LOGD(POOL_HEATER_TAG, "Command #%u queued (%u frame(s))", ticket, ctrl_frames.size());
+    }
+    return ticket;
 }
 void PoolHeater::control(const climate::ClimateCall& call) {
     HWPCall hwpcall(call, *this, this->hp_data_, *this->actual_status_sensor_);
@@ -293,7 +677,9 @@ void PoolHeater::set_update_active(bool active) {
     this->update_active_ = active;
     ESP_LOGD(POOL_HEATER_TAG, "Setting update sensors: %s", ONOFF(active));
 }
-void PoolHeater::generate_code() { BaseFrame::dump_c_code(POOL_HEATER_TAG); }
+void PoolHeater::generate_code() {
+    BaseFrame::dump_c_code(POOL_HEATER_TAG, this->driver_.get_registry());
+}
 bool PoolHeater::get_passive_mode() { return this->passive_mode_; }
 bool PoolHeater::is_update_active() { return this->update_active_; }
 
@@ -35,6 +35,8 @@
 
 #pragma once
 #include "Bus.h"
+#include "FaultLog.h"
+#include "FrameTypes.h"
 #include "HeaterStatus.h"
 #include "base_frame.h"
 #include "esphome/components/climate/climate.h"
@@ -44,6 +46,9 @@
 #include "esphome/core/component.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/macros.h"
+#ifdef USE_API
+#include "esphome/components/api/custom_api_device.h"
+#endif
 
 /**
  * @brief Describes the structure and timing of packets on the NET port.
@@ -96,15 +101,24 @@ namespace hwp {
 
 static constexpr uint8_t POOLHEATER_TEMP_MIN = 15;
 static constexpr uint8_t POOLHEATER_TEMP_MAX = 33;
+static constexpr uint32_t default_preferences_save_interval_ms = 5 * 60 * 1000;
 extern const char* POOL_HEATER_TAG;
 
 /**
  * @brief Class to handle communication with the pool heater.
  */
-class PoolHeater : public climate::Climate, public PollingComponent {
+class PoolHeater : public climate::Climate,
+                   public PollingComponent
+#ifdef USE_API
+    ,
+                   public api::CustomAPIDevice
+#endif
+{
   public:
     PoolHeater(InternalGPIOPin* gpio_pin);
     void update() override;
+    void on_shutdown() override;
+    void loop() override;
     void set_out_temperature_sensor(sensor::Sensor* sensor);
     void set_actual_status_sensor(text_sensor::TextSensor* sensor);
     void set_heater_status_code_sensor(text_sensor::TextSensor* sensor);
@@ -194,6 +208,130 @@ class PoolHeater : public climate::Climate, public PollingComponent {
         this->u02_pulses_per_liter_ = sensor;
     }
 
+    // Diagnostic sensors
+    void set_tx_arm_time_sensor(sensor::Sensor* sensor) { this->tx_arm_time_ = sensor; }
+    void set_tx_merged_commands_sensor(sensor::Sensor* sensor) {
+        this->tx_merged_commands_ = sensor;
+    }
+    void set_tx_dropped_commands_sensor(sensor::Sensor* sensor) {
+        this->tx_dropped_commands_ = sensor;
+    }
+    void set_tx_expired_commands_sensor(sensor::Sensor* sensor) {
+        this->tx_expired_commands_ = sensor;
+    }
+    void set_tx_queue_wait_time_sensor(sensor::Sensor* sensor) {
+        this->tx_queue_wait_time_ = sensor;
+    }
+    void set_tx_queue_depth_sensor(sensor::Sensor* sensor) { this->tx_queue_depth_ = sensor; }
+    void set_tx_repeats_per_command_sensor(sensor::Sensor* sensor) {
+        this->tx_repeats_per_command_ = sensor;
+    }
+    void set_tx_confirm_latency_sensor(sensor::Sensor* sensor) {
+        this->tx_confirm_latency_ = sensor;
+    }
+    void set_tx_collisions_sensor(sensor::Sensor* sensor) { this->tx_collisions_ = sensor; }
+    void set_bus_utilization_sensor(sensor::Sensor* sensor) { this->bus_utilization_ = sensor; }
+    void set_tx_retries_sensor(sensor::Sensor* sensor) { this->tx_retries_ = sensor; }
+    void set_rx_stack_free_sensor(sensor::Sensor* sensor) { this->rx_stack_free_ = sensor; }
+    void set_rx_dropped_edges_sensor(sensor::Sensor* sensor) { this->rx_dropped_edges_ = sensor; }
+    void set_isr_max_time_sensor(sensor::Sensor* sensor) { this->isr_max_time_ = sensor; }
+    void set_rx_recovered_frames_sensor(sensor::Sensor* sensor) {
+        this->rx_recovered_frames_ = sensor;
+    }
+    void set_frame_end_latency_sensor(sensor::Sensor* sensor) {
+        this->frame_end_latency_ = sensor;
+    }
+    void set_tx_timing_error_sensor(sensor::Sensor* sensor) { this->tx_timing_error_ = sensor; }
+    void set_rx_processing_lag_sensor(sensor::Sensor* sensor) {
+        this->rx_processing_lag_ = sensor;
+    }
+    void set_rx_ring_high_water_sensor(sensor::Sensor* sensor) {
+        this->rx_ring_high_water_ = sensor;
+    }
+    void set_frame_pool_heap_fallbacks_sensor(sensor::Sensor* sensor) {
+        this->frame_pool_heap_fallbacks_ = sensor;
+    }
+    void set_heap_min_free_sensor(sensor::Sensor* sensor) { this->heap_min_free_ = sensor; }
+    void set_heap_largest_free_block_sensor(sensor::Sensor* sensor) {
+        this->heap_largest_free_block_ = sensor;
+    }
+    void set_alloc_main_bytes_sensor(sensor::Sensor* sensor) { this->alloc_main_bytes_ = sensor; }
+    void set_alloc_rx_bytes_sensor(sensor::Sensor* sensor) { this->alloc_rx_bytes_ = sensor; }
+    void set_state_valid_time_sensor(sensor::Sensor* sensor) { this->state_valid_time_ = sensor; }
+    void set_state_confirmed_time_sensor(sensor::Sensor* sensor) {
+        this->state_confirmed_time_ = sensor;
+    }
+
+    /**
+     * @brief Sets the stack size of the decode worker, which runs both directions of all the
+     * buses, in bytes.
+     */
+    void set_task_stack_size(uint32_t stack_size) { DecodeWorker::set_stack_size(stack_size); }
+
+    /**
+     * @brief Sets the core (-1 for any) and priority of the decode worker.
+     *
+     * The decode worker is shared by all the heaters, so it keeps the highest priority asked.
+     */
+    void set_task_affinity(int8_t core, uint8_t priority) {
+        DecodeWorker::set_task_affinity(core, priority);
+    }
+
+    /**
+     * @brief Enables closed-loop transmissions confirmed by the heater echo.
+     * @param repeat_group Number of repeats before listening for the echo the first time.
+     * @param confirm_window_ms How long to listen for the echo after each group of repeats.
+     */
+    void set_adaptive_repeats(bool enabled, uint8_t repeat_group, uint32_t confirm_window_ms) {
+        this->driver_.set_adaptive_repeats(enabled, repeat_group, confirm_window_ms);
+    }
+
+    /**
+     * @brief Enables the repair of damaged frames from their least confident bits.
+     */
+    void set_frame_repair(bool enabled) { this->driver_.set_frame_repair(enabled); }
+    /**
+     * @brief Enables collision detection by reading back the line while transmitting.
+     * @param max_retries Number of retries before a burst is abandoned.
+     * @param backoff_ms Base delay before retrying, doubled and jittered on each retry.
+     */
+    void set_collision_detect(bool enabled, uint8_t max_retries, uint32_t backoff_ms) {
+        this->driver_.set_collision_detect(enabled, max_retries, backoff_ms);
+    }
+
+    /**
+     * @brief Sets how long the bus must be idle before transmissions are armed at startup.
+     * @param window_ms The idle window in milliseconds.
+     */
+    void set_tx_ready_idle_window(uint32_t window_ms) {
+        this->driver_.set_tx_ready_idle_window(window_ms);
+    }
+
+    /**
+     * @brief Sets how long a command may wait for a free bus slot before it is discarded.
+     * @param expiry_ms The deadline in milliseconds, counted from the last queued change.
+     */
+    void set_tx_command_expiry(uint32_t expiry_ms) {
+        this->driver_.set_tx_command_expiry(expiry_ms);
+    }
+
+    /**
+     * @brief Sets how the fault events are batched before being written to flash.
+     * @param interval_ms Longest time an event stays unsaved.
+     * @param batch Number of unsaved events that triggers a write right away.
+     */
+    void set_fault_log_flush_policy(uint32_t interval_ms, uint8_t batch) {
+        this->fault_log_.set_flush_policy(interval_ms, batch);
+    }
+    const FaultLog& get_fault_log() const { return this->fault_log_; }
+
+    /**
+     * @brief Sets the minimum delay between two writes of the persisted state.
+     */
+    void set_preferences_save_interval(uint32_t interval_ms) {
+        this->preferences_save_interval_ms_ = interval_ms;
+    }
+
     /**
      * @brief Handle control requests from Home Assistant.
      * @param call The control call.
@@ -220,13 +358,60 @@ class PoolHeater : public climate::Climate, public PollingComponent {
     bool get_passive_mode();
     bool is_update_active();
     heat_pump_data_t& data() { return hp_data_; }
-    void control(const HWPCall& call);
+    /**
+     * @brief Queues the frames applying a call.
+     *
+     * The outcome is reported later through the command callbacks, with the same ticket.
+     *
+     * @return The command ticket, or no_command_ticket if nothing was queued.
+     */
+    command_ticket_t control(const HWPCall& call);
+    /**
+     * @brief Gets the ticket of the last control call, e.g. from a lambda run right after a
+     * climate.control action or a change of one of the settings entities.
+     */
+    command_ticket_t get_last_command_ticket() const { return this->last_command_ticket_; }
+    /**
+     * @brief Sets how long the heater has to echo a command before it is reported as failed.
+     */
+    void set_command_timeout(uint32_t timeout_ms) { this->driver_.set_command_timeout(timeout_ms); }
+    /**
+     * @brief Adds a callback run from the main loop once the heater applied a command.
+     *
+     * Receives the ticket, the time from queuing to the heater echo in milliseconds and the
+     * type byte of the last frame echoed.
+     */
+    void add_on_command_confirmed_callback(
+        std::function<void(uint32_t, uint32_t, uint8_t)>&& callback) {
+        this->command_confirmed_callback_.add(std::move(callback));
+    }
+    /**
+     * @brief Adds a callback run from the main loop when a command did not reach the heater.
+     *
+     * Receives the ticket, the reason (timeout, expired, dropped or collision) and the type
+     * byte of the frame that failed. A command merged into a newer change of the same settings
+     * ends with that newer command.
+     */
+    void add_on_command_failed_callback(
+        std::function<void(uint32_t, std::string, uint8_t)>&& callback) {
+        this->command_failed_callback_.add(std::move(callback));
+    }
     void generate_code();
 
   protected:
     heat_pump_data_t hp_data_;
     Bus driver_; ///< The bus driver for communication.
     HeaterStatus heater_status_;
+    uint16_t published_status_index_{UINT16_MAX}; ///< Status last sent to the text sensors
+    uint8_t logged_status_index_{error_index_waiting}; ///< Last status checked for the fault log
+    FaultLog fault_log_;
+    CallbackManager<void(uint32_t, uint32_t, uint8_t)> command_confirmed_callback_;
+    CallbackManager<void(uint32_t, std::string, uint8_t)> command_failed_callback_;
+    command_ticket_t last_command_ticket_{no_command_ticket};
+#ifdef USE_API
+    void on_fault_log_service_();
+    void on_clear_fault_log_service_();
+#endif
     std::string actual_status_;
     bool passive_mode_ = true;
     bool update_active_ = false;
@@ -258,6 +443,34 @@ class PoolHeater : public climate::Climate, public PollingComponent {
     number::Number* d05_min_economy_defrost_time_minutes_;
     number::Number* u02_pulses_per_liter_;
 
+    // Diagnostic sensors (only created when configured)
+    sensor::Sensor* tx_arm_time_{nullptr}; ///< Time from startup until TX was armed
+    sensor::Sensor* tx_merged_commands_{nullptr};  ///< Commands coalesced in the TX queue
+    sensor::Sensor* tx_dropped_commands_{nullptr}; ///< Commands dropped by the TX queue
+    sensor::Sensor* tx_expired_commands_{nullptr}; ///< Commands discarded as stale
+    sensor::Sensor* tx_queue_wait_time_{nullptr};  ///< Average time commands wait to be sent
+    sensor::Sensor* tx_queue_depth_{nullptr};      ///< Commands currently pending
+    sensor::Sensor* tx_repeats_per_command_{nullptr}; ///< Average repeats in closed-loop mode
+    sensor::Sensor* tx_confirm_latency_{nullptr};     ///< Average heater echo delay
+    sensor::Sensor* tx_collisions_{nullptr};          ///< Bursts aborted by a collision
+    sensor::Sensor* bus_utilization_{nullptr};        ///< Share of the time the bus is held
+    sensor::Sensor* tx_retries_{nullptr};             ///< Bursts retried after a collision
+    sensor::Sensor* rx_stack_free_{nullptr};          ///< Decode worker stack high-water mark
+    sensor::Sensor* rx_dropped_edges_{nullptr};       ///< Edges lost on a full ring buffer
+    sensor::Sensor* rx_ring_high_water_{nullptr};     ///< Highest ring buffer fill level
+    sensor::Sensor* isr_max_time_{nullptr};           ///< Worst case edge interrupt duration
+    sensor::Sensor* frame_end_latency_{nullptr};      ///< Average frame end detection delay
+    sensor::Sensor* tx_timing_error_{nullptr};        ///< Average error on the sent levels
+    sensor::Sensor* rx_processing_lag_{nullptr};      ///< Average edge to decoder delay
+    sensor::Sensor* rx_recovered_frames_{nullptr};    ///< Frames rebuilt from damaged copies
+    sensor::Sensor* frame_pool_heap_fallbacks_{nullptr}; ///< Frames allocated on the heap
+    sensor::Sensor* heap_min_free_{nullptr};           ///< Lowest free heap since boot
+    sensor::Sensor* heap_largest_free_block_{nullptr}; ///< Largest allocatable block
+    sensor::Sensor* alloc_main_bytes_{nullptr}; ///< Bytes allocated from the main loop
+    sensor::Sensor* alloc_rx_bytes_{nullptr};   ///< Bytes allocated from the decode worker
+    sensor::Sensor* state_valid_time_{nullptr};     ///< Time to the first usable state
+    sensor::Sensor* state_confirmed_time_{nullptr}; ///< Time until the bus confirmed it
+
     // Specific temperature sensors
     sensor::Sensor* t01_temperature_suction_; ///< Suction temperature sensor (T01)
     sensor::Sensor* t04_temperature_coil_;           ///< Coil temperature sensor (T04)
@@ -296,43 +509,45 @@ class PoolHeater : public climate::Climate, public PollingComponent {
      */
     bool serialize_command_frame(BaseFrame* frameptr, float temperature, climate::ClimateMode mode);
 
-    ESPPreferenceObject preferences_;
+    static constexpr uint32_t preferences_version = 2;
+    /// One slot per known frame class, a new class changes the size and so the saved layout
+    static constexpr size_t persisted_frames_count = frame_types::size;
+    /// The configuration frames, whose changes are worth a flash write
+    static constexpr size_t first_settings_class = frame_types::index_of<FrameConf1>();
+    static constexpr size_t last_settings_class = frame_types::index_of<FrameConf6>();
+    static_assert(last_settings_class - first_settings_class == 5,
+        "the configuration frames must be adjacent in frame_types");
+    /**
+     * @brief State saved to flash so the component is usable right after a reboot.
+     */
     struct PoolHeaterPreferences {
-        bool dummy;
+        uint32_t version;
+        float target_temperature; ///< NAN when unknown
+        uint8_t mode;             ///< climate::ClimateMode, UINT8_MAX when unknown
+        uint8_t frame_sources[persisted_frames_count]; ///< SOURCE_UNKNOWN for empty slots
+        hp_packetdata_t frames[persisted_frames_count];
+        burst_timing_t timings[BURST_ORIGIN_COUNT];
     };
+    ESPPreferenceObject preferences_;
+    PoolHeaterPreferences saved_preferences_{}; ///< Last state written to flash
+    uint32_t preferences_save_interval_ms_{default_preferences_save_interval_ms};
+    uint32_t last_preferences_save_ms_{0};
+    uint32_t preferences_writes_{0};
     void setup() override;
     void dump_config() override;
-    void restore_preferences_() {
-        // PoolHeaterPreferences prefs;
-        // if (preferences_.load(&prefs)) {
-        //   // currentTemperatureSource
-        //   if (prefs.currentTemperatureSourceIndex.has_value() &&
-        //       temperature_source_select_->has_index(prefs.currentTemperatureSourceIndex.value())
-        //       &&
-        //       temperature_source_select_->at(prefs.currentTemperatureSourceIndex.value()).has_value())
-        //       {
-        //     current_temperature_source_ =
-        //     temperature_source_select_->at(prefs.currentTemperatureSourceIndex.value()).value();
-        //     temperature_source_select_->publish_state(current_temperature_source_);
-        //     ESP_LOGCONFIG(TAG, "Preferences loaded.");
-        //   } else {
-        //     ESP_LOGCONFIG(TAG, "Preferences loaded, but unsuitable values.");
-        //     current_temperature_source_ = TEMPERATURE_SOURCE_INTERNAL;
-        //     temperature_source_select_->publish_state(TEMPERATURE_SOURCE_INTERNAL);
-        //   }
-        // } else {
-        //   // TODO: Shouldn't need to define setting all these defaults twice
-        //   ESP_LOGCONFIG(TAG, "Preferences not loaded.");
-        //   current_temperature_source_ = TEMPERATURE_SOURCE_INTERNAL;
-        //   temperature_source_select_->publish_state(TEMPERATURE_SOURCE_INTERNAL);
-        // }
-    }
-
-    void save_preferences_() {
-        // todo: implement saving preferences
-        //  PoolHeaterPreferences prefs{};
-        //  preferences_.save(&prefs);
-    }
+    void restore_preferences_();
+    /**
+     * @brief Saves the state if the settings changed, at most once per save interval.
+     * @param force True to save any change right away (e.g. on shutdown).
+     */
+    void save_preferences_(bool force = false);
+    void collect_preferences_(PoolHeaterPreferences& prefs);
+    /**
+     * @brief Tells if the setpoints or a configuration frame differ from the saved state.
+     */
+    bool is_settings_change_(const PoolHeaterPreferences& prefs) const;
+    optional<uint32_t> state_valid_ms_;     ///< Uptime at which the state could first be shown
+    optional<uint32_t> state_confirmed_ms_; ///< Uptime at which no restored frame was left
 
     template <typename T, typename U>
     void publish_sensor_value(const optional<U>& value, T* sensor) {
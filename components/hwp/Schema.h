@@ -1899,6 +1899,12 @@ typedef struct {
     /// @brief Last controller frame
     optional<uint32_t> last_controller_frame;
 
+    /// @brief Raw error code reported by the heater. The high bit is set for hardware (Pxx)
+    /// faults and the low 7 bits hold the code number. No frame field has been identified as
+    /// carrying it yet, so it stays empty until the protocol analysis finds one.
+    /// @see HeaterStatus
+    optional<uint8_t> heater_error;
+
     /// @brief Indicates if a Flow Meter is installed and enabled
     /// @see FlowMeterEnable
     optional<FlowMeterEnable> U01_flow_meter;
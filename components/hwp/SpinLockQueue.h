@@ -5,6 +5,7 @@
 #include <freertos/semphr.h>
 #include <freertos/task.h>
 
+#include "AllocTelemetry.h"
 #include "SpinLock.h"
 #include "esphome/core/log.h"
 
@@ -78,6 +79,7 @@ template <typename T> class SpinLockQueue {
      * @param element The element to enqueue.
      */
     void inline enqueue(const T& element) {
+        HWP_ALLOC_SCOPE(ALLOC_SITE_SPINLOCK_QUEUE);
         this->spinlock.lock();
         if (this->logging_enabled) {
             ESP_LOGV(SPINLOCK_TAG, "enqueue: Attempting to enqueue element");
@@ -110,6 +112,22 @@ template <typename T> class SpinLockQueue {
      */
     bool has_next() { return !this->queue.empty(); }
 
+    /**
+     * @brief Copies the element at the front of the queue without removing it.
+     * @param element Receives a copy of the front element.
+     * @return true If the queue was not empty.
+     * @return false If the queue is empty.
+     */
+    bool peek(T* element) {
+        this->spinlock.lock();
+        bool found = !this->queue.empty();
+        if (found) {
+            *element = this->queue.front();
+        }
+        this->spinlock.unlock();
+        return found;
+    }
+
     /**
      * @brief Dequeues an element from the queue.
      *
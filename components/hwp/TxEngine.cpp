@@ -0,0 +1,61 @@
+/**
+ * @file TxEngine.cpp
+ * @brief Implementation of the non-blocking transmitter levels.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include "TxEngine.h"
+
+namespace esphome {
+namespace hwp {
+
+void TxEngine::append_level(bool high, uint32_t duration_ms) {
+    uint32_t duration_us = duration_ms * 1000;
+    if (!this->levels_.empty() && this->levels_.back().high == high) {
+        this->levels_.back().duration_us += duration_us;
+    } else {
+        this->levels_.push_back({duration_us, high});
+    }
+    this->duration_us_ += duration_us;
+}
+
+bool TxEngine::next_level(tx_level_t& level) {
+    if (this->index_ >= this->levels_.size()) {
+        this->state_ = TX_ENGINE_SENT;
+        return false;
+    }
+    level = this->levels_[this->index_++];
+    return true;
+}
+
+} // namespace hwp
+} // namespace esphome
@@ -0,0 +1,165 @@
+/**
+ * @file TxEngine.h
+ * @brief Levels and states of the non-blocking transmitter.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @brief One level driven on the line while transmitting.
+ */
+typedef struct {
+    uint32_t duration_us;
+    bool high;
+} tx_level_t;
+
+/**
+ * @enum tx_engine_state_t
+ * @brief Steps of a transmission, from picking frames to the end of the confirmation window.
+ */
+typedef enum {
+    TX_ENGINE_IDLE,      ///< Waiting for frames to send and for a free bus slot
+    TX_ENGINE_SENDING,   ///< The levels are being played on the line
+    TX_ENGINE_SENT,      ///< The last level was played, or the playback was aborted
+    TX_ENGINE_LISTENING, ///< Closed-loop mode, waiting for the heater echo
+    TX_ENGINE_SETTLING,  ///< Letting a frame that started during the window end
+} tx_engine_state_t;
+
+/**
+ * @class TxEngine
+ * @brief Holds the levels of a burst and the state of the transmitter between two steps.
+ *
+ * Nothing here waits: the levels are played one at a time by whoever owns the line (a
+ * one-shot timer on the device), and the waits between steps are deadlines checked by the
+ * task servicing the bus. The owner moves the engine from one state to the next.
+ *
+ * Like the BusScheduler, the class has no dependency on the hardware or on the logger. Times
+ * are passed in, so a burst can be stepped against any clock, and deadlines are compared so
+ * that the 32 bits millis() wrap is harmless.
+ */
+class TxEngine {
+  public:
+    /**
+     * @brief Removes all the levels. Only allowed while not sending.
+     */
+    void clear() {
+        this->levels_.clear();
+        this->duration_us_ = 0;
+        this->index_ = 0;
+        this->readback_levels_ = SIZE_MAX;
+    }
+
+    /**
+     * @brief Appends a level, merged with the previous one if it is the same.
+     */
+    void append_level(bool high, uint32_t duration_ms);
+
+    size_t size() const { return this->levels_.size(); }
+    /**
+     * @brief Ends the levels read back for collisions with those appended so far.
+     *
+     * The levels appended next only hold the bus, like the group spacing of open-loop mode
+     * during which the heater may already answer.
+     */
+    void end_readback() { this->readback_levels_ = this->levels_.size(); }
+    /**
+     * @brief Tells whether the level returned last by next_level() is read back.
+     */
+    bool is_readback_level() const { return this->index_ <= this->readback_levels_; }
+    /**
+     * @brief Gets the time it takes to play all the levels, in microseconds.
+     */
+    uint32_t get_duration_us() const { return this->duration_us_; }
+
+    /**
+     * @brief Starts playing the levels from the first one.
+     */
+    void start() {
+        this->index_ = 0;
+        this->state_ = TX_ENGINE_SENDING;
+    }
+
+    /**
+     * @brief Gets the next level to drive on the line.
+     *
+     * The next step is due `level.duration_us` after the level is driven. Once every level
+     * was returned, the engine moves to TX_ENGINE_SENT.
+     *
+     * @param level Receives the level.
+     * @return false If there is no level left.
+     */
+    bool next_level(tx_level_t& level);
+
+    /**
+     * @brief Stops playing the remaining levels, e.g. after a collision.
+     */
+    void abort() { this->state_ = TX_ENGINE_SENT; }
+
+    tx_engine_state_t get_state() const { return this->state_; }
+    bool is_idle() const { return this->state_ == TX_ENGINE_IDLE; }
+    void set_idle() { this->state_ = TX_ENGINE_IDLE; }
+
+    /**
+     * @brief Moves to a waiting state that ends at the given time.
+     */
+    void wait_until(tx_engine_state_t state, uint32_t deadline_ms) {
+        this->state_ = state;
+        this->deadline_ms_ = deadline_ms;
+    }
+
+    /**
+     * @brief Gets the time left before the deadline of the current state, 0 once passed.
+     */
+    uint32_t time_left(uint32_t now_ms) const {
+        int32_t left = static_cast<int32_t>(this->deadline_ms_ - now_ms);
+        return left > 0 ? static_cast<uint32_t>(left) : 0;
+    }
+
+  protected:
+    std::vector<tx_level_t> levels_;
+    uint32_t duration_us_{0};
+    size_t index_{0}; ///< Next level to play
+    size_t readback_levels_{SIZE_MAX}; ///< Number of levels read back, see end_readback()
+    volatile tx_engine_state_t state_{TX_ENGINE_IDLE}; ///< Moved to SENT by the step timer
+    uint32_t deadline_ms_{0};
+};
+
+} // namespace hwp
+} // namespace esphome
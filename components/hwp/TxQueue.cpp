@@ -0,0 +1,258 @@
+/**
+ * @file TxQueue.cpp
+ * @brief Implementation of the coalescing transmit queue.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+
+#include "TxQueue.h"
+#include "FrameTypes.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace hwp {
+static const char* TAG_TXQ = "hwp.txq";
+
+tx_priority_t TxQueue::priority_of(const BaseFrame& frame) {
+    size_t type_id = frame.get_type_id();
+    // frames learned at runtime are not in the table
+    if (type_id >= frame_types::size) return TX_PRIORITY_NORMAL;
+    return frame_types::classes[type_id].tx_priority;
+}
+
+std::deque<tx_queue_entry_t>::iterator TxQueue::insert_position(tx_priority_t priority) {
+    auto it = this->queue_.begin();
+    while (it != this->queue_.end() && it->priority >= priority) {
+        ++it;
+    }
+    return it;
+}
+
+std::deque<tx_queue_entry_t>::iterator TxQueue::eviction_candidate() {
+    // the lowest priority entries are at the back; the oldest of them goes first
+    tx_priority_t lowest = this->queue_.back().priority;
+    auto victim = this->insert_position(static_cast<tx_priority_t>(lowest + 1));
+    for (auto it = victim; it != this->queue_.end(); ++it) {
+        if (static_cast<int32_t>(it->queued_ms - victim->queued_ms) < 0) victim = it;
+    }
+    return victim;
+}
+
+size_t TxQueue::expire(uint32_t now_ms, std::vector<std::shared_ptr<BaseFrame>>& expired) {
+    size_t count = 0;
+    for (auto it = this->queue_.begin(); it != this->queue_.end();) {
+        if (static_cast<int32_t>(now_ms - it->deadline_ms) >= 0) {
+            expired.push_back(it->frame);
+            it = this->queue_.erase(it);
+            count++;
+        } else {
+            ++it;
+        }
+    }
+    this->stats_.expired += count;
+    return count;
+}
+
+void TxQueue::report(
+    const std::vector<std::shared_ptr<BaseFrame>>& frames, command_outcome_t outcome,
+    uint32_t now_ms) {
+    if (this->tracker_ == nullptr) return;
+    for (const auto& frame : frames) {
+        this->tracker_->on_discarded(*frame, outcome, now_ms);
+    }
+}
+
+tx_enqueue_result_t TxQueue::enqueue(const std::shared_ptr<BaseFrame>& frame, uint32_t now_ms) {
+    bool merged = false;
+    bool dropped = false;
+    bool rejected = false;
+    tx_priority_t priority = priority_of(*frame);
+    std::vector<std::shared_ptr<BaseFrame>> expired;
+    std::shared_ptr<BaseFrame> replaced;
+    std::vector<std::shared_ptr<BaseFrame>> evicted;
+    this->spinlock_.lock();
+    this->expire(now_ms, expired);
+    this->stats_.enqueued++;
+    for (auto& pending : this->queue_) {
+        if (is_same_type(*pending.frame, *frame)) {
+            replaced = pending.frame;
+            pending.frame = frame;
+            pending.deadline_ms = now_ms + this->expiry_ms_;
+            merged = true;
+            this->stats_.merged++;
+            break;
+        }
+    }
+    if (!merged) {
+        if (this->queue_.size() >= this->max_len_) {
+            auto victim = this->eviction_candidate();
+            this->stats_.dropped++;
+            if (victim->priority > priority) {
+                evicted.push_back(frame);
+                rejected = true;
+            } else {
+                evicted.push_back(victim->frame);
+                this->queue_.erase(victim);
+                dropped = true;
+            }
+        }
+        if (!rejected) {
+            this->queue_.insert(this->insert_position(priority),
+                {frame, priority, now_ms, now_ms + this->expiry_ms_});
+        }
+    }
+    size_t size = this->queue_.size();
+    this->spinlock_.unlock();
+    this->report(expired, COMMAND_EXPIRED, now_ms);
+    if (replaced && this->tracker_ != nullptr) this->tracker_->on_merged(*replaced, frame);
+    this->report(evicted, COMMAND_DROPPED, now_ms);
+
+    if (!expired.empty()) {
+        ESP_LOGW(TAG_TXQ, "Discarded %zu stale pending frame(s)", expired.size());
+    }
+    if (merged) {
+        ESP_LOGD(TAG_TXQ, "Merged %s into pending frame (%zu pending)", frame->type_string(), size);
+    } else if (dropped) {
+        ESP_LOGW(TAG_TXQ, "Queue full, dropped oldest lowest priority pending frame");
+    } else if (rejected) {
+        ESP_LOGW(TAG_TXQ, "Queue full of higher priority frames, dropped %s",
+            frame->type_string());
+        return TX_ENQUEUE_REJECTED;
+    }
+    if (this->task_handle_ != nullptr) {
+        xTaskNotifyGive(this->task_handle_);
+    }
+    if (merged) return TX_ENQUEUE_MERGED;
+    return dropped ? TX_ENQUEUE_EVICTED : TX_ENQUEUE_ADDED;
+}
+
+std::shared_ptr<BaseFrame> TxQueue::find_pending(const BaseFrame& frame) {
+    std::shared_ptr<BaseFrame> result;
+    this->spinlock_.lock();
+    for (const auto& pending : this->queue_) {
+        if (is_same_type(*pending.frame, frame)) {
+            result = pending.frame;
+            break;
+        }
+    }
+    this->spinlock_.unlock();
+    return result;
+}
+
+std::vector<std::shared_ptr<BaseFrame>> TxQueue::pending(uint32_t now_ms) {
+    std::vector<std::shared_ptr<BaseFrame>> result;
+    std::vector<std::shared_ptr<BaseFrame>> expired;
+    this->spinlock_.lock();
+    this->expire(now_ms, expired);
+    result.reserve(this->queue_.size());
+    for (const auto& pending : this->queue_) {
+        result.push_back(pending.frame);
+    }
+    this->spinlock_.unlock();
+    this->report(expired, COMMAND_EXPIRED, now_ms);
+    if (!expired.empty()) {
+        ESP_LOGW(TAG_TXQ, "Discarded %zu stale pending frame(s)", expired.size());
+    }
+    return result;
+}
+
+void TxQueue::requeue(const std::vector<std::shared_ptr<BaseFrame>>& frames, uint32_t now_ms) {
+    // frames put back, and the newer pending frames carrying their changes
+    std::vector<std::pair<std::shared_ptr<BaseFrame>, std::shared_ptr<BaseFrame>>> superseded;
+    std::vector<std::shared_ptr<BaseFrame>> evicted;
+    this->spinlock_.lock();
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        std::shared_ptr<BaseFrame> newer;
+        for (const auto& pending : this->queue_) {
+            if (is_same_type(*pending.frame, **it)) {
+                newer = pending.frame;
+                break;
+            }
+        }
+        if (newer) {
+            superseded.emplace_back(*it, newer);
+            continue;
+        }
+        tx_priority_t priority = priority_of(**it);
+        if (this->queue_.size() >= this->max_len_) {
+            auto victim = this->eviction_candidate();
+            this->stats_.dropped++;
+            if (victim->priority >= priority) {
+                evicted.push_back(*it);
+                continue;
+            }
+            evicted.push_back(victim->frame);
+            this->queue_.erase(victim);
+        }
+        // ahead of the frames of the same priority, which were queued after this one
+        auto pos = this->queue_.begin();
+        while (pos != this->queue_.end() && pos->priority > priority) {
+            ++pos;
+        }
+        this->queue_.insert(pos, {*it, priority, now_ms, now_ms + this->expiry_ms_});
+    }
+    this->spinlock_.unlock();
+    if (this->tracker_ != nullptr) {
+        for (const auto& merge : superseded) this->tracker_->on_merged(*merge.first, merge.second);
+    }
+    this->report(evicted, COMMAND_DROPPED, now_ms);
+}
+
+std::vector<std::shared_ptr<BaseFrame>> TxQueue::take_all(uint32_t now_ms) {
+    std::vector<std::shared_ptr<BaseFrame>> result;
+    std::vector<std::shared_ptr<BaseFrame>> expired;
+    this->spinlock_.lock();
+    this->expire(now_ms, expired);
+    result.reserve(this->queue_.size());
+    for (const auto& pending : this->queue_) {
+        uint32_t wait = now_ms - pending.queued_ms;
+        this->stats_.avg_wait_ms =
+            this->stats_.sent == 0 ? wait : (this->stats_.avg_wait_ms * 3 + wait) / 4;
+        this->stats_.last_wait_ms = wait;
+        if (wait > this->stats_.max_wait_ms) this->stats_.max_wait_ms = wait;
+        this->stats_.sent++;
+        result.push_back(pending.frame);
+    }
+    this->queue_.clear();
+    if (!result.empty()) {
+        this->stats_.bursts++;
+    }
+    this->spinlock_.unlock();
+    this->report(expired, COMMAND_EXPIRED, now_ms);
+    if (!expired.empty()) {
+        ESP_LOGW(TAG_TXQ, "Discarded %zu stale pending frame(s)", expired.size());
+    }
+    return result;
+}
+
+} // namespace hwp
+} // namespace esphome
@@ -0,0 +1,208 @@
+/**
+ * @file TxQueue.h
+ * @brief Transmit queue that coalesces pending commands of the same frame type.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "CommandTracker.h"
+#include "SpinLock.h"
+#include "base_frame.h"
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @brief Counters describing what happened to the commands handed to the queue.
+ */
+typedef struct {
+    uint32_t enqueued;     ///< Commands handed to the queue
+    uint32_t merged;       ///< Commands folded into a pending frame of the same type
+    uint32_t dropped;      ///< Pending frames discarded because the queue was full
+    uint32_t expired;      ///< Pending frames discarded because they waited past their deadline
+    uint32_t sent;         ///< Frames handed over to the transmitter
+    uint32_t bursts;       ///< Batches handed over to the transmitter
+    uint32_t last_wait_ms; ///< Time the last frame sent spent in the queue
+    uint32_t max_wait_ms;  ///< Longest time a frame sent spent in the queue
+    uint32_t avg_wait_ms;  ///< Moving average of the time frames spend in the queue
+} tx_queue_stats_t;
+
+/**
+ * @brief What happened to a frame handed to TxQueue::enqueue().
+ */
+typedef enum {
+    TX_ENQUEUE_ADDED,    ///< Queued after the pending frames of the same or a higher priority
+    TX_ENQUEUE_MERGED,   ///< Replaced the pending frame of the same type
+    TX_ENQUEUE_EVICTED,  ///< Queued, at the expense of a lower priority pending frame
+    TX_ENQUEUE_REJECTED, ///< Not queued, the queue is full of higher priority frames
+} tx_enqueue_result_t;
+
+/**
+ * @brief A pending frame with its priority and timing.
+ */
+typedef struct {
+    std::shared_ptr<BaseFrame> frame;
+    tx_priority_t priority;
+    uint32_t queued_ms;   ///< When the first command still carried by the frame was queued
+    uint32_t deadline_ms; ///< When the frame becomes stale, refreshed by every merged command
+} tx_queue_entry_t;
+
+/**
+ * @class TxQueue
+ * @brief Holds at most one pending frame per frame type, highest priority first.
+ *
+ * Commands built from a pending frame carry every change accumulated so far, so queuing a new
+ * frame of a type that is already pending replaces it in place instead of appending: the
+ * queued frame is always the latest state for its type and keeps its original position.
+ *
+ * Frames are ordered by the priority of their type (see frame_types), then in first-queued
+ * order. When the queue is full, the oldest frame of the lowest priority is dropped, so a
+ * burst of low value settings can't evict a pending power or mode change. A frame still
+ * pending once its deadline is past is discarded as stale rather than sent late.
+ *
+ * The transmitter takes the whole content of the queue at once, so all changed types go out
+ * in a single burst.
+ */
+class TxQueue {
+  public:
+    static constexpr uint32_t default_expiry_ms = 5 * 60 * 1000;
+
+    /**
+     * @brief Constructs a new TxQueue.
+     * @param max_len Maximum number of distinct frame types pending at once.
+     * @param expiry_ms How long a frame may stay pending before it is discarded.
+     */
+    explicit TxQueue(size_t max_len, uint32_t expiry_ms = default_expiry_ms)
+        : max_len_(max_len), expiry_ms_(expiry_ms) {}
+
+    /**
+     * @brief Sets the task handle to notify when a frame is queued.
+     */
+    void set_task_handle(TaskHandle_t handle) { this->task_handle_ = handle; }
+    /**
+     * @brief Sets the tracker told about the frames merged or leaving the queue unsent.
+     */
+    void set_tracker(CommandTracker* tracker) { this->tracker_ = tracker; }
+    /**
+     * @brief Sets how long a frame may stay pending before it is discarded, in milliseconds.
+     */
+    void set_expiry(uint32_t expiry_ms) { this->expiry_ms_ = expiry_ms; }
+    uint32_t get_expiry() const { return this->expiry_ms_; }
+
+    /**
+     * @brief Gets the transmit priority of a frame, from its entry in frame_types.
+     */
+    static tx_priority_t priority_of(const BaseFrame& frame);
+
+    /**
+     * @brief Queues a frame, replacing any pending frame of the same type.
+     *
+     * If the queue is full, the oldest frame of the lowest priority is dropped; that may be
+     * the new frame itself if everything pending ranks higher.
+     *
+     * @param frame The frame to send.
+     * @param now_ms The current time.
+     * @return What happened to the frame.
+     */
+    tx_enqueue_result_t enqueue(const std::shared_ptr<BaseFrame>& frame, uint32_t now_ms);
+
+    /**
+     * @brief Returns the pending frame of the same type as `frame`, if any.
+     *
+     * Used to build new commands on top of what is already waiting to be sent.
+     */
+    std::shared_ptr<BaseFrame> find_pending(const BaseFrame& frame);
+
+    /**
+     * @brief Copies the pending frames without removing them, e.g. to size a transmit slot.
+     *
+     * Stale frames are discarded first.
+     */
+    std::vector<std::shared_ptr<BaseFrame>> pending(uint32_t now_ms);
+
+    /**
+     * @brief Puts back frames that could not be sent, ahead of the frames of the same priority.
+     *
+     * A frame is only put back if no newer frame of the same type was queued in the meantime,
+     * as the newer one already carries its changes. The frames get a new deadline. If the queue
+     * filled up in the meantime, the oldest pending frame of the lowest priority makes room
+     * when it ranks below the frame put back, otherwise the frame put back is dropped.
+     */
+    void requeue(const std::vector<std::shared_ptr<BaseFrame>>& frames, uint32_t now_ms);
+
+    /**
+     * @brief Removes and returns every pending frame that is not stale, in queue order.
+     */
+    std::vector<std::shared_ptr<BaseFrame>> take_all(uint32_t now_ms);
+
+    bool has_next() { return !this->queue_.empty(); }
+    size_t size() { return this->queue_.size(); }
+    const tx_queue_stats_t& get_stats() const { return this->stats_; }
+
+  protected:
+    static bool is_same_type(const BaseFrame& lhs, const BaseFrame& rhs) {
+        return lhs.packet.get_type() == rhs.packet.get_type() &&
+               lhs.packet.data_len == rhs.packet.data_len;
+    }
+    /// @brief Position after the last entry ranking at least `priority`. Lock must be held.
+    std::deque<tx_queue_entry_t>::iterator insert_position(tx_priority_t priority);
+    /// @brief Oldest entry of the lowest priority, the first to go when the queue is full.
+    /// The queue must not be empty. Lock must be held.
+    std::deque<tx_queue_entry_t>::iterator eviction_candidate();
+    /// @brief Moves the stale entries to `expired`. Lock must be held.
+    size_t expire(uint32_t now_ms, std::vector<std::shared_ptr<BaseFrame>>& expired);
+    /// @brief Tells the tracker about discarded frames. Lock must not be held.
+    void report(const std::vector<std::shared_ptr<BaseFrame>>& frames, command_outcome_t outcome,
+        uint32_t now_ms);
+
+    Spinlock spinlock_;
+    std::deque<tx_queue_entry_t> queue_;
+    size_t max_len_;
+    uint32_t expiry_ms_;
+    TaskHandle_t task_handle_{nullptr};
+    CommandTracker* tracker_{nullptr};
+    tx_queue_stats_t stats_{};
+};
+
+} // namespace hwp
+} // namespace esphome
@@ -0,0 +1,80 @@
+/**
+ * @file automation.h
+ * @brief Automation triggers reporting the outcome of the commands sent to the heater.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "PoolHeater.h"
+#include "esphome/core/automation.h"
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @brief Fires once the heater echoed every frame of a command.
+ *
+ * Arguments: the command ticket, the time from queuing to the echo in milliseconds and the
+ * type byte of the last frame echoed.
+ */
+class CommandConfirmedTrigger : public Trigger<uint32_t, uint32_t, uint8_t> {
+  public:
+    explicit CommandConfirmedTrigger(PoolHeater* parent) {
+        parent->add_on_command_confirmed_callback(
+            [this](uint32_t ticket, uint32_t elapsed_ms, uint8_t frame_type) {
+                this->trigger(ticket, elapsed_ms, frame_type);
+            });
+    }
+};
+
+/**
+ * @brief Fires when a command did not reach the heater.
+ *
+ * Arguments: the command ticket, the reason (see CommandTracker::outcome_to_string()) and
+ * the type byte of the frame that failed.
+ */
+class CommandFailedTrigger : public Trigger<uint32_t, std::string, uint8_t> {
+  public:
+    explicit CommandFailedTrigger(PoolHeater* parent) {
+        parent->add_on_command_failed_callback(
+            [this](uint32_t ticket, std::string reason, uint8_t frame_type) {
+                this->trigger(ticket, reason, frame_type);
+            });
+    }
+};
+
+} // namespace hwp
+} // namespace esphome
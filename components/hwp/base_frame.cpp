@@ -31,13 +31,15 @@
  * for any damage or loss caused by the use of this software.
  */
 #include "base_frame.h"
+#include "FrameTypes.h"
+#ifdef USE_HWP_DEFERRED_LOGGING
+#include <deque>
+#include "SpinLock.h"
+#endif
 
 namespace esphome {
 namespace hwp {
 const char* TAG_PACKET = "hwp.pk";
-// Static member definition.
-std::vector<BaseFrame::frame_registry_t> BaseFrame::registry_;
-
 // Constructors.
 BaseFrame::BaseFrame()
     : packet(), transmitBitIndex(0), finalized(false), source_(SOURCE_UNKNOWN),
@@ -75,34 +77,46 @@ BaseFrame& BaseFrame::operator=(const BaseFrame& other) {
 }
 
 // Static methods.
-std::vector<BaseFrame::frame_registry_t>& BaseFrame::get_registry() { return registry_; }
-
-std::shared_ptr<BaseFrame> BaseFrame::base_create() { return std::make_shared<BaseFrame>(); }
+std::shared_ptr<BaseFrame> BaseFrame::base_create() { return make_pooled_frame<BaseFrame>(); }
 
 bool BaseFrame::base_matches(BaseFrame& specialized, BaseFrame& base) {
     return *specialized.byte_signature_ == base.packet.get_type();
 }
 
-size_t BaseFrame::register_frame_class(
-    FrameFactoryMethod factory, FrameMatchesMethod match_method) {
-    auto& registry = BaseFrame::get_registry();
-    size_t index = registry.size();
-    registry.push_back({factory, match_method, factory()});
-    return index;
-}
 optional<std::shared_ptr<BaseFrame>> BaseFrame::control(const HWPCall& call) { return nullopt; }
 
 
-BaseFrame::frame_registry_t* BaseFrame::get_registry_by_id(size_t type_id) {
-    auto& registry = BaseFrame::get_registry();
-    if (type_id < registry.size()) {
-        return &registry[type_id];
+FrameRegistry::FrameRegistry() {
+    const auto& classes = frame_types::classes;
+    this->entries_.reserve(classes.size());
+    for (size_t i = 0; i < classes.size(); i++) {
+        this->entries_.push_back({classes[i].factory, classes[i].matches, classes[i].factory()});
+        this->entries_.back().instance->type_id_ = i;
     }
-    return nullptr;
 }
 
-void BaseFrame::dump_known_packets(const char* caller_tag) {
-    auto& registry = BaseFrame::get_registry();
+std::shared_ptr<BaseFrame> FrameRegistry::find(BaseFrame& frame) {
+    const auto& range = frame_types::ranges[frame.packet.get_type()];
+    for (size_t i = range.first; i < static_cast<size_t>(range.first) + range.count; i++) {
+        if (this->entries_[i].matches(*this->entries_[i].instance.get(), frame)) {
+            return this->entries_[i].instance;
+        }
+    }
+    for (size_t i = frame_types::size; i < this->entries_.size(); i++) {
+        if (this->entries_[i].matches(*this->entries_[i].instance.get(), frame)) {
+            return this->entries_[i].instance;
+        }
+    }
+    size_t new_type_id = this->entries_.size();
+    this->entries_.push_back(
+        {&BaseFrame::base_create, &BaseFrame::base_matches, BaseFrame::base_create()});
+    auto& instance = this->entries_.back().instance;
+    instance->type_id_ = new_type_id;
+    instance->byte_signature_ = frame.packet.get_type();
+    return instance;
+}
+
+void BaseFrame::dump_known_packets(const char* caller_tag, FrameRegistry& registry) {
     size_t count = 0;
     for (size_t i = 0; i < registry.size(); i++) {
         if (registry[i].instance->has_previous_data()) {
@@ -123,22 +137,8 @@ void BaseFrame::dump_known_packets(const char* caller_tag) {
 }
 
 
-std::shared_ptr<BaseFrame> BaseFrame::get_specialized() {
-    auto& registry = BaseFrame::get_registry();
-    for (size_t i = 0; i < registry.size(); i++) {
-        if (registry[i].matches(*registry[i].instance.get(), *this)) {
-            return registry[i].instance;
-        }
-    }
-    auto new_type_id = register_frame_class(&BaseFrame::base_create, &BaseFrame::base_matches);
-    frame_registry_t* new_registry_entry = get_registry_by_id(new_type_id);
-    if (!new_registry_entry) {
-        ESP_LOGE(TAG_BF, "Failed to register frame type %d", new_type_id);
-        return nullptr;
-    }
-    new_registry_entry->instance->type_id_ = new_type_id;
-    new_registry_entry->instance->byte_signature_ = this->packet.get_type();
-    return new_registry_entry->instance;
+std::shared_ptr<BaseFrame> BaseFrame::get_specialized(FrameRegistry& registry) {
+    return registry.find(*this);
 }
 
 // Other member functions.
@@ -146,6 +146,9 @@ void BaseFrame::initialize() {}
 
 void BaseFrame::parse(heat_pump_data_t& data) {}
 size_t BaseFrame::get_type_id() const { return this->type_id_; }
+std::shared_ptr<BaseFrame> BaseFrame::clone() const {
+    return make_pooled_frame<BaseFrame>(*this);
+}
 bool BaseFrame::is_changed() const {
     return !this->has_previous_data() || this->packet != this->prev_.value();
 };
@@ -261,11 +264,8 @@ std::string BaseFrame::header_format(const std::string& prefix, bool no_diff) co
     return cs.str();
 }
 
-void BaseFrame::print(
+static void print_frame(
     const std::string& prefix, const BaseFrame& frame, const char* tag, int min_level, int line) {
-    if (!log_active(tag, min_level)) {
-        return;
-    }
     CS cs;
     bool changed = frame.is_changed();
     cs.set_changed_base_color(changed);
@@ -274,6 +274,59 @@ void BaseFrame::print(
     esp_log_printf_(min_level, tag, line, ESPHOME_LOG_FORMAT("%s%s"),
         frame.header_format(prefix).c_str(), formatted_frame.c_str());
 }
+
+#ifdef USE_HWP_DEFERRED_LOGGING
+typedef struct {
+    std::shared_ptr<BaseFrame> frame;
+    std::string prefix;
+    const char* tag;
+    int min_level;
+    int line;
+} deferred_print_t;
+
+static constexpr size_t max_deferred_prints = 24;
+static Spinlock deferred_lock;
+static std::deque<deferred_print_t> deferred_prints;
+static uint32_t deferred_prints_dropped = 0;
+
+void BaseFrame::flush_deferred_prints() {
+    while (true) {
+        deferred_lock.lock();
+        if (deferred_prints.empty()) {
+            deferred_lock.unlock();
+            return;
+        }
+        deferred_print_t entry = std::move(deferred_prints.front());
+        deferred_prints.pop_front();
+        deferred_lock.unlock();
+        print_frame(entry.prefix, *entry.frame, entry.tag, entry.min_level, entry.line);
+    }
+}
+uint32_t BaseFrame::get_deferred_prints_dropped() { return deferred_prints_dropped; }
+#endif
+
+void BaseFrame::print(
+    const std::string& prefix, const BaseFrame& frame, const char* tag, int min_level, int line) {
+    if (!log_active(tag, min_level)) {
+        return;
+    }
+#ifdef USE_HWP_DEFERRED_LOGGING
+    // Snapshot the frame, including the previous data used for the diff, and let the main
+    // loop do the formatting.
+    auto snapshot = frame.clone();
+    snapshot->prev_ = frame.prev_;
+    snapshot->frame_age_ms_ = frame.frame_age_ms_;
+    deferred_lock.lock();
+    if (deferred_prints.size() >= max_deferred_prints) {
+        deferred_prints.pop_front();
+        deferred_prints_dropped++;
+    }
+    deferred_prints.push_back({snapshot, prefix, tag, min_level, line});
+    deferred_lock.unlock();
+#else
+    print_frame(prefix, frame, tag, min_level, line);
+#endif
+}
 void BaseFrame::print_prev(
     const std::string& prefix, const BaseFrame& frame, const char* tag, int min_level, int line) {
     if (!log_active(tag, min_level)) {
@@ -385,13 +438,16 @@ std::string BaseFrame::to_string(const std::string& prefix) const {
 }
 
 
-std::shared_ptr<BaseFrame> BaseFrame::process(heat_pump_data_t& hp_data) {
-    auto specialized = get_specialized();
+std::shared_ptr<BaseFrame> BaseFrame::process(
+    heat_pump_data_t& hp_data, FrameRegistry& registry) {
+    HWP_ALLOC_SCOPE(ALLOC_SITE_FRAME_PROCESS);
+    auto specialized = get_specialized(registry);
     if (specialized) {
         auto prev_save = this->packet;
         specialized->frame_age_ms_ = millis() - specialized->frame_time_ms_;
         specialized->frame_time_ms_ = millis();
         specialized->stage(*this); // Transfer the data to the specialized frame
+        specialized->restored_ = this->restored_;
         ESP_LOGVV(TAG_BF, "Specialized frame found. Cur size: %d, %s", this->packet.data_len,
             specialized->type_string());
         ESP_LOGVV(TAG_BF, "(%d)%s", specialized->packet.data_len,
@@ -464,10 +520,9 @@ const char* BaseFrame::source_string(frame_source_t source) {
 }
 
 
-void BaseFrame::dump_c_code(const char* caller_tag) {
+void BaseFrame::dump_c_code(const char* caller_tag, FrameRegistry& registry) {
     CS cs;
 
-    auto& registry = BaseFrame::get_registry();
     size_t count = 0;
     for (size_t i = 0; i < registry.size(); i++) {
         if (registry[i].instance->packet.data_len > 0) {
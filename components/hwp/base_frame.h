@@ -32,13 +32,16 @@
  */
 #pragma once
 
+#include "AllocTelemetry.h"
 #include "CS.h"
+#include "FramePool.h"
 #include "HPUtils.h"
 #include "Schema.h"
 #include "hwp_call.h"
 
 #include "esphome/components/climate/climate.h"
 #include "esphome/components/logger/logger.h"
+#include "esphome/core/defines.h"
 #include "esphome/core/helpers.h"   // esphome::millis()
 #include "esphome/core/log.h"
 
@@ -71,7 +74,7 @@ namespace hwp {
 //   - ambiguous operator= from optional<T> = packet_data
 //
 #define CLASS_DEFAULT_IMPL(DerivedFrameClass, type_name)                                             \
-  static size_t class_type_id;                                                                       \
+  static const size_t class_type_id;                                                                 \
   DerivedFrameClass() : BaseFrame(), data_(), prev_data_() {}                                         \
   DerivedFrameClass(const BaseFrame &base) : BaseFrame(base), data_(), prev_data_() {                 \
     /* stage() will populate data_ properly */                                                        \
@@ -104,6 +107,9 @@ namespace hwp {
   std::string format(bool no_diff = false) const override;                                            \
   std::string format_prev() const override;                                                           \
   const char *type_string() const override;                                                           \
+  std::shared_ptr<BaseFrame> clone() const override {                                                 \
+    return make_pooled_frame<DerivedFrameClass>(*this);                                               \
+  }                                                                                                   \
   bool is_changed() const override {                                                                  \
     return !prev_data_.has_value() || !data_.has_value() || (*this->data_ != this->prev_data_.value());\
   }                                                                                                   \
@@ -115,10 +121,13 @@ namespace hwp {
   }                                                                                                   \
   void parse(heat_pump_data_t &hp_data) override;
 
-// Define the macro to accept a fully qualified class name.
+// Define the macro to accept a fully qualified class name. The class type id is its position in
+// frame_types (FrameTypes.h), which must be included by the translation unit.
 #define CLASS_ID_DECLARATION(FullClassName)                                                           \
-  size_t FullClassName::class_type_id =                                                               \
-      BaseFrame::register_frame_class(&FullClassName::create, &FullClassName::matches);
+  static_assert(esphome::hwp::frame_types::index_of<FullClassName>() <                                \
+                    esphome::hwp::frame_types::size,                                                  \
+      "add " #FullClassName " to frame_types in FrameTypes.h");                                        \
+  const size_t FullClassName::class_type_id = esphome::hwp::frame_types::index_of<FullClassName>();
 
 #define REGISTER_FRAME_ID_DEFAULT(DerivedFrameClass)
 
@@ -126,6 +135,8 @@ namespace hwp {
 // Enums / constants
 // -----------------------------------------------------------------------------
 typedef enum { SOURCE_UNKNOWN, SOURCE_HEATER, SOURCE_CONTROLLER, SOURCE_LOCAL } frame_source_t;
+/// Order in which pending commands are sent; the lowest ones are dropped first when full
+typedef enum { TX_PRIORITY_LOW, TX_PRIORITY_NORMAL, TX_PRIORITY_HIGH } tx_priority_t;
 
 static constexpr uint16_t pulse_duration_threshold_us = 600;
 static constexpr uint32_t frame_heading_low_duration_ms = 9;
@@ -145,10 +156,14 @@ static constexpr const char TAG_BF_HEX[] = "hwp.hex";
 static constexpr uint32_t frame_heading_total_duration_ms =
     frame_heading_low_duration_ms + frame_heading_high_duration_ms;
 
+class FrameRegistry;
+
 // -----------------------------------------------------------------------------
 // BaseFrame
 // -----------------------------------------------------------------------------
 class BaseFrame {
+  friend class FrameRegistry;
+
  public:
   using FrameFactoryMethod = std::shared_ptr<BaseFrame> (*)();
   using FrameMatchesMethod = bool (*)(BaseFrame &specialized, BaseFrame &base);
@@ -159,10 +174,8 @@ class BaseFrame {
     std::shared_ptr<BaseFrame> instance;
   } frame_registry_t;
 
-  static std::vector<frame_registry_t> &get_registry();
   static std::shared_ptr<BaseFrame> base_create();
   static bool base_matches(BaseFrame &specialized, BaseFrame &base);
-  static size_t register_frame_class(FrameFactoryMethod factory, FrameMatchesMethod match_method);
 
   BaseFrame();
   BaseFrame(const BaseFrame &other);
@@ -202,6 +215,8 @@ class BaseFrame {
   virtual std::string format_prev() const;
   virtual size_t get_type_id() const;
   virtual bool is_changed() const;
+  /// @brief Copies the frame, keeping its specialized type.
+  virtual std::shared_ptr<BaseFrame> clone() const;
   virtual const char *type_string() const;
 
   virtual esphome::optional<std::shared_ptr<BaseFrame>> control(const HWPCall &call);
@@ -231,6 +246,14 @@ class BaseFrame {
   static void print(const std::string &prefix, const BaseFrame &frame, const char *tag,
                     int min_level, int line);
   void print(const std::string &prefix, const char *tag, int min_level, int line) const;
+#ifdef USE_HWP_DEFERRED_LOGGING
+  /// @brief Formats and logs the frames printed from the bus task since the last call.
+  ///
+  /// With deferred logging, print() only snapshots the frame so that the string formatting,
+  /// and the stack it needs, happen in the main loop rather than in the bus task.
+  static void flush_deferred_prints();
+  static uint32_t get_deferred_prints_dropped();
+#endif
 
   static void print_diff(const std::string &prefix, const BaseFrame &frame, const char *tag,
                          int min_level, int line);
@@ -254,7 +277,7 @@ class BaseFrame {
     return logger::global_logger != nullptr;
   }
 
-  static void dump_known_packets(const char *CALLER_TAG);
+  static void dump_known_packets(const char *CALLER_TAG, FrameRegistry &registry);
 
   template <size_t N>
   static void debug_print_hex(const uint8_t (&buffer)[N], const size_t length,
@@ -264,44 +287,85 @@ class BaseFrame {
   size_t size() const;
   bool is_size_valid() const;
   bool is_valid() const;
+  /// @brief True if the frame was restored from flash and not yet seen on the bus.
+  bool is_restored() const { return this->restored_; }
 
   void inverse();
   std::string to_string(const std::string &prefix) const;
 
-  template <typename T>
-  static std::shared_ptr<T> get() {
-    auto &registry = get_registry();
-    if (T::class_type_id < registry.size()) {
-      return std::static_pointer_cast<T>(registry[T::class_type_id].instance);
-    }
-    return nullptr;
-  }
-
   hp_packetdata_t packet;
   size_t transmitBitIndex;
   bool finalized;
 
   static uint8_t reverse_bits(unsigned char x);
-  static void dump_c_code(const char *caller_tag);
+  static void dump_c_code(const char *caller_tag, FrameRegistry &registry);
 
  protected:
   frame_source_t source_;
   uint32_t frame_time_ms_;
   uint32_t frame_age_ms_;
+  bool restored_ = false;  ///< True while the data comes from the warm-start cache
   size_t type_id_ = 0;
 
   esphome::optional<uint8_t> byte_signature_ = 0;
   esphome::optional<hp_packetdata_t> prev_;
 
-  static std::vector<frame_registry_t> registry_;
-
   virtual void transfer();
   virtual void stage(const BaseFrame &base);
 
-  std::shared_ptr<BaseFrame> get_specialized();
-  std::shared_ptr<BaseFrame> process(heat_pump_data_t &hp_data);
+  std::shared_ptr<BaseFrame> get_specialized(FrameRegistry &registry);
+  std::shared_ptr<BaseFrame> process(heat_pump_data_t &hp_data, FrameRegistry &registry);
+};
+
+// -----------------------------------------------------------------------------
+// FrameRegistry
+// -----------------------------------------------------------------------------
+/**
+ * @brief The last seen state of every frame type, for one bus.
+ *
+ * Each Bus owns one registry, built from the constexpr frame_types table, so that several
+ * heaters handled by the same chip keep their own previous-frame state and diffs. Known
+ * classes keep their class type id as index; frame types that match no known class are
+ * appended to the registry of the bus they were seen on.
+ */
+class FrameRegistry {
+ public:
+  FrameRegistry();
+
+  size_t size() const { return this->entries_.size(); }
+  BaseFrame::frame_registry_t &operator[](size_t index) { return this->entries_[index]; }
+
+  /// @brief Finds the instance holding the state of the class matching `frame`, adding a
+  /// generic entry if no class matches.
+  ///
+  /// Only the classes declared for the packet type byte are tried, in priority order.
+  std::shared_ptr<BaseFrame> find(BaseFrame &frame);
+  /// @brief Processes a frame that did not come from the bus decoder.
+  ///
+  /// The matching instance is marked as restored until the same type is received from the bus.
+  std::shared_ptr<BaseFrame> replay(BaseFrame &frame, heat_pump_data_t &hp_data) {
+    frame.restored_ = true;
+    return frame.process(hp_data, *this);
+  }
+  /// @brief Counts the instances still holding restored data.
+  size_t restored_count() const {
+    size_t count = 0;
+    for (const auto &entry : this->entries_) {
+      if (entry.instance->is_restored()) count++;
+    }
+    return count;
+  }
+
+  template <typename T>
+  std::shared_ptr<T> get() {
+    if (T::class_type_id < this->entries_.size()) {
+      return std::static_pointer_cast<T>(this->entries_[T::class_type_id].instance);
+    }
+    return nullptr;
+  }
 
-  frame_registry_t *get_registry_by_id(size_t type_id);
+ protected:
+  std::vector<BaseFrame::frame_registry_t> entries_;
 };
 
 }  // namespace hwp
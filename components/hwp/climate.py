@@ -10,7 +10,8 @@ import logging
 
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome import core, pins
+from esphome import automation, core, pins
+from esphome.core import CORE
 from esphome.components import (
     binary_sensor,
     button,
@@ -29,14 +30,19 @@ from esphome.const import (
     CONF_NUMBER,
     CONF_OUTPUT,
     CONF_SENSORS,
+    CONF_TRIGGER_ID,
     CONF_UPDATE_INTERVAL,
     DEVICE_CLASS_DURATION,
     DEVICE_CLASS_TEMPERATURE,
     ENTITY_CATEGORY_CONFIG,
     ENTITY_CATEGORY_DIAGNOSTIC,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
     UNIT_CELSIUS,
+    UNIT_MICROSECOND,
+    UNIT_MILLISECOND,
     UNIT_MINUTE,
+    UNIT_PERCENT,
 )
 
 _LOGGER = logging.getLogger(__name__)
@@ -68,6 +74,55 @@ CONF_UPDATE_SENSORS_SWITCH = "update_sensors_switch"
 CONF_GENERATE_CODE_BUTTON = "generate_code"
 
 CONF_GPIO_NETPIN = "pin_txrx"
+CONF_TX_READY_IDLE_WINDOW = "tx_ready_idle_window"
+CONF_TX_COMMAND_EXPIRY = "tx_command_expiry"
+CONF_COMMAND_TIMEOUT = "command_timeout"
+CONF_ON_COMMAND_CONFIRMED = "on_command_confirmed"
+CONF_ON_COMMAND_FAILED = "on_command_failed"
+CONF_TX_ADAPTIVE_REPEATS = "tx_adaptive_repeats"
+CONF_TX_REPEAT_GROUP = "tx_repeat_group"
+CONF_TX_CONFIRM_WINDOW = "tx_confirm_window"
+CONF_TX_COLLISION_DETECT = "tx_collision_detect"
+CONF_TX_COLLISION_MAX_RETRIES = "tx_collision_max_retries"
+CONF_TX_COLLISION_BACKOFF = "tx_collision_backoff"
+CONF_RX_STACK_SIZE = "rx_stack_size"
+CONF_RX_TASK_CORE = "rx_task_core"
+CONF_RX_TASK_PRIORITY = "rx_task_priority"
+CONF_DEFERRED_LOGGING = "deferred_logging"
+CONF_ALLOC_TELEMETRY = "alloc_telemetry"
+CONF_FAULT_LOG_FLUSH_INTERVAL = "fault_log_flush_interval"
+CONF_FAULT_LOG_FLUSH_BATCH = "fault_log_flush_batch"
+CONF_PREFERENCES_SAVE_INTERVAL = "preferences_save_interval"
+CONF_RX_FRAME_REPAIR = "rx_frame_repair"
+CONF_DIAGNOSTICS = "diagnostics"
+
+# Diagnostics (only created when listed in the configuration)
+CONF_TX_ARM_TIME = "tx_arm_time"
+CONF_TX_MERGED_COMMANDS = "tx_merged_commands"
+CONF_TX_DROPPED_COMMANDS = "tx_dropped_commands"
+CONF_TX_EXPIRED_COMMANDS = "tx_expired_commands"
+CONF_TX_QUEUE_WAIT_TIME = "tx_queue_wait_time"
+CONF_TX_QUEUE_DEPTH = "tx_queue_depth"
+CONF_TX_REPEATS_PER_COMMAND = "tx_repeats_per_command"
+CONF_TX_CONFIRM_LATENCY = "tx_confirm_latency"
+CONF_TX_COLLISIONS = "tx_collisions"
+CONF_BUS_UTILIZATION = "bus_utilization"
+CONF_TX_RETRIES = "tx_retries"
+CONF_RX_STACK_FREE = "rx_stack_free"
+CONF_RX_DROPPED_EDGES = "rx_dropped_edges"
+CONF_RX_RING_HIGH_WATER = "rx_ring_high_water"
+CONF_ISR_MAX_TIME = "isr_max_time"
+CONF_FRAME_END_LATENCY = "frame_end_latency"
+CONF_TX_TIMING_ERROR = "tx_timing_error"
+CONF_RX_PROCESSING_LAG = "rx_processing_lag"
+CONF_RX_RECOVERED_FRAMES = "rx_recovered_frames"
+CONF_FRAME_POOL_HEAP_FALLBACKS = "frame_pool_heap_fallbacks"
+CONF_HEAP_MIN_FREE = "heap_min_free"
+CONF_HEAP_LARGEST_FREE_BLOCK = "heap_largest_free_block"
+CONF_ALLOC_MAIN_BYTES = "alloc_main_bytes"
+CONF_ALLOC_RX_BYTES = "alloc_rx_bytes"
+CONF_STATE_VALID_TIME = "state_valid_time"
+CONF_STATE_CONFIRMED_TIME = "state_confirmed_time"
 
 # Temperatures / status
 CONF_TEMPERATURE_SUCTION = "suction_temperature_T01"
@@ -127,6 +182,12 @@ PoolHeater = hwp_ns.class_("PoolHeater", cg.Component, climate.Climate)
 ActiveModeSwitch = hwp_ns.class_("ActiveModeSwitch", switch.Switch, cg.Component)
 UpdateStatusSwitch = hwp_ns.class_("UpdateStatusSwitch", switch.Switch, cg.Component)
 GenerateCodeButton = hwp_ns.class_("GenerateCodeButton", button.Button, cg.Component, cg.Parented)
+CommandConfirmedTrigger = hwp_ns.class_(
+    "CommandConfirmedTrigger", automation.Trigger.template(cg.uint32, cg.uint32, cg.uint8)
+)
+CommandFailedTrigger = hwp_ns.class_(
+    "CommandFailedTrigger", automation.Trigger.template(cg.uint32, cg.std_string, cg.uint8)
+)
 
 # -----------------------------------------------------------------------------
 # Helpers
@@ -175,6 +236,88 @@ BASE_SCHEMA = climate.climate_schema(PoolHeater).extend(
             entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
             icon="mdi:code-tags",
         ),
+        # How long the bus must be quiet before transmissions are armed at startup
+        cv.Optional(CONF_TX_READY_IDLE_WINDOW, default="1s"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(milliseconds=100),
+                max=core.TimePeriod(seconds=60),
+            ),
+        ),
+        # Discard commands still waiting for a free bus slot after this long, as stale
+        cv.Optional(CONF_TX_COMMAND_EXPIRY, default="5min"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(seconds=10),
+                max=core.TimePeriod(hours=1),
+            ),
+        ),
+        # How long the heater has to echo a sent command before on_command_failed fires
+        cv.Optional(CONF_COMMAND_TIMEOUT, default="30s"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(seconds=1),
+                max=core.TimePeriod(minutes=10),
+            ),
+        ),
+        # Run once the heater applied a command (ticket, elapsed_ms, frame_type)
+        cv.Optional(CONF_ON_COMMAND_CONFIRMED): automation.validate_automation(
+            {cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(CommandConfirmedTrigger)}
+        ),
+        # Run when a command did not reach the heater (ticket, reason, frame_type)
+        cv.Optional(CONF_ON_COMMAND_FAILED): automation.validate_automation(
+            {cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(CommandFailedTrigger)}
+        ),
+        # Stop repeating a command once the heater echoes it back
+        cv.Optional(CONF_TX_ADAPTIVE_REPEATS, default=False): cv.boolean,
+        cv.Optional(CONF_TX_REPEAT_GROUP, default=2): cv.int_range(min=1, max=8),
+        cv.Optional(CONF_TX_CONFIRM_WINDOW, default="2500ms"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(milliseconds=500),
+                max=core.TimePeriod(seconds=10),
+            ),
+        ),
+        # Read the line back while transmitting (pin driven open drain) and retry on collision
+        cv.Optional(CONF_TX_COLLISION_DETECT, default=False): cv.boolean,
+        cv.Optional(CONF_TX_COLLISION_MAX_RETRIES, default=3): cv.int_range(min=0, max=10),
+        cv.Optional(CONF_TX_COLLISION_BACKOFF, default="500ms"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(milliseconds=50),
+                max=core.TimePeriod(seconds=10),
+            ),
+        ),
+        # Stack of the bus task (decoding and transmitting), in bytes. Use the rx_stack_free
+        # diagnostic to size it.
+        cv.Optional(CONF_RX_STACK_SIZE, default=15360): cv.int_range(min=2048, max=32768),
+        # Bus task placement: -1 lets FreeRTOS pick the core. Use the rx_processing_lag
+        # diagnostic to see whether the task gets preempted.
+        cv.Optional(CONF_RX_TASK_CORE, default=-1): cv.int_range(min=-1, max=1),
+        cv.Optional(CONF_RX_TASK_PRIORITY, default=1): cv.int_range(min=1, max=24),
+        # Repair damaged frames by flipping up to 3 bits with the least timing margin
+        cv.Optional(CONF_RX_FRAME_REPAIR, default=False): cv.boolean,
+        # Format the frame logs in the main loop instead of the bus task
+        cv.Optional(CONF_DEFERRED_LOGGING, default=False): cv.boolean,
+        # Count every operator new per task and per hwp code path (replaces the global new)
+        cv.Optional(CONF_ALLOC_TELEMETRY, default=False): cv.boolean,
+        # Fault events are written to flash once a batch is pending or after the interval
+        cv.Optional(CONF_FAULT_LOG_FLUSH_INTERVAL, default="10min"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(seconds=10),
+                max=core.TimePeriod(hours=24),
+            ),
+        ),
+        cv.Optional(CONF_FAULT_LOG_FLUSH_BATCH, default=4): cv.int_range(min=1, max=16),
+        # Minimum delay between two writes of the saved state (setpoints, frames, bus timings)
+        cv.Optional(CONF_PREFERENCES_SAVE_INTERVAL, default="5min"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=core.TimePeriod(seconds=30),
+                max=core.TimePeriod(hours=24),
+            ),
+        ),
         cv.Optional(CONF_UPDATE_INTERVAL, default="30s"): cv.All(
             cv.positive_time_period_milliseconds,
             cv.Range(
@@ -509,6 +652,320 @@ SENSORS: dict[str, tuple] = {
     ),
 }
 
+# -----------------------------------------------------------------------------
+# Diagnostic entities (same layout as SENSORS, but opt-in)
+# -----------------------------------------------------------------------------
+DIAGNOSTICS: dict[str, tuple] = {
+    CONF_TX_ARM_TIME: (
+        "TX Arm Time",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-play-outline",
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_MERGED_COMMANDS: (
+        "TX Merged Commands",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:call-merge",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_DROPPED_COMMANDS: (
+        "TX Dropped Commands",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:delete-alert-outline",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_EXPIRED_COMMANDS: (
+        "TX Expired Commands",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:timer-remove-outline",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_QUEUE_WAIT_TIME: (
+        "TX Queue Wait Time",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-sand",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_QUEUE_DEPTH: (
+        "TX Queue Depth",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:tray-full",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_REPEATS_PER_COMMAND: (
+        "TX Repeats Per Command",
+        sensor.sensor_schema(
+            accuracy_decimals=2,
+            icon="mdi:repeat",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_CONFIRM_LATENCY: (
+        "TX Confirmation Latency",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-check-outline",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_BUS_UTILIZATION: (
+        "Bus Utilization",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            accuracy_decimals=1,
+            icon="mdi:chart-donut",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_COLLISIONS: (
+        "TX Collisions",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:car-brake-alert",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_RETRIES: (
+        "TX Retries",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:restart",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_RX_STACK_FREE: (
+        "RX Stack Free",
+        sensor.sensor_schema(
+            unit_of_measurement="B",
+            accuracy_decimals=0,
+            icon="mdi:memory",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_RX_DROPPED_EDGES: (
+        "RX Dropped Edges",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:wave-undetected",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_RX_RING_HIGH_WATER: (
+        "RX Ring High Water",
+        sensor.sensor_schema(
+            unit_of_measurement="B",
+            accuracy_decimals=0,
+            icon="mdi:tray-full",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_ISR_MAX_TIME: (
+        "Edge ISR Max Time",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=1,
+            icon="mdi:timer-alert-outline",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_FRAME_END_LATENCY: (
+        "Frame End Latency",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-stop-outline",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_TX_TIMING_ERROR: (
+        "TX Timing Error",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:sine-wave",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_RX_PROCESSING_LAG: (
+        "RX Processing Lag",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-sand",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_RX_RECOVERED_FRAMES: (
+        "RX Recovered Frames",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:vote-outline",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_FRAME_POOL_HEAP_FALLBACKS: (
+        "Frame Pool Heap Fallbacks",
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            icon="mdi:memory",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_HEAP_MIN_FREE: (
+        "Heap Min Free",
+        sensor.sensor_schema(
+            unit_of_measurement="B",
+            accuracy_decimals=0,
+            icon="mdi:memory",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_HEAP_LARGEST_FREE_BLOCK: (
+        "Heap Largest Free Block",
+        sensor.sensor_schema(
+            unit_of_measurement="B",
+            accuracy_decimals=0,
+            icon="mdi:memory",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_ALLOC_MAIN_BYTES: (
+        "Allocated Bytes Main Loop",
+        sensor.sensor_schema(
+            unit_of_measurement="B",
+            accuracy_decimals=0,
+            icon="mdi:chart-line",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_ALLOC_RX_BYTES: (
+        "Allocated Bytes RX",
+        sensor.sensor_schema(
+            unit_of_measurement="B",
+            accuracy_decimals=0,
+            icon="mdi:chart-line",
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_STATE_VALID_TIME: (
+        "State Valid Time",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-play-outline",
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+    CONF_STATE_CONFIRMED_TIME: (
+        "State Confirmed Time",
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            icon="mdi:timer-check-outline",
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        sensor.register_sensor,
+        None,
+    ),
+}
+
 # -----------------------------------------------------------------------------
 # Build sensor schema dict
 # -----------------------------------------------------------------------------
@@ -531,6 +988,18 @@ SENSORS_SCHEMA = cv.All(
     }
 )
 
+DIAGNOSTICS_SCHEMA = cv.All(
+    {
+        cv.Optional(sensor_designator): sensor_schema
+        for sensor_designator, (
+            _sensor_name,
+            sensor_schema,
+            _register_fn,
+            _filter_creation,
+        ) in DIAGNOSTICS.items()
+    }
+)
+
 # -----------------------------------------------------------------------------
 # Dynamically declare codegen classes for inputs and build input schema dict
 # -----------------------------------------------------------------------------
@@ -566,6 +1035,7 @@ CONFIG_SCHEMA = BASE_SCHEMA.extend(
     {
         cv.Optional(CONF_SENSORS, default={}): SENSORS_SCHEMA,
         cv.Optional(CONF_INPUT, default={}): INPUTS_SCHEMA,
+        cv.Optional(CONF_DIAGNOSTICS, default={}): DIAGNOSTICS_SCHEMA,
     }
 )
 
@@ -579,6 +1049,74 @@ async def to_code(config):
     heater_component = cg.new_Pvariable(config[CONF_ID], pin_component)
     await cg.register_component(heater_component, config)
     await climate.register_climate(heater_component, config)
+    cg.add(
+        heater_component.set_tx_ready_idle_window(
+            config[CONF_TX_READY_IDLE_WINDOW].total_milliseconds
+        )
+    )
+    cg.add(
+        heater_component.set_tx_command_expiry(
+            config[CONF_TX_COMMAND_EXPIRY].total_milliseconds
+        )
+    )
+    cg.add(heater_component.set_command_timeout(config[CONF_COMMAND_TIMEOUT].total_milliseconds))
+    for conf in config.get(CONF_ON_COMMAND_CONFIRMED, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], heater_component)
+        await automation.build_automation(
+            trigger,
+            [(cg.uint32, "ticket"), (cg.uint32, "elapsed_ms"), (cg.uint8, "frame_type")],
+            conf,
+        )
+    for conf in config.get(CONF_ON_COMMAND_FAILED, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], heater_component)
+        await automation.build_automation(
+            trigger,
+            [(cg.uint32, "ticket"), (cg.std_string, "reason"), (cg.uint8, "frame_type")],
+            conf,
+        )
+    cg.add(
+        heater_component.set_adaptive_repeats(
+            config[CONF_TX_ADAPTIVE_REPEATS],
+            config[CONF_TX_REPEAT_GROUP],
+            config[CONF_TX_CONFIRM_WINDOW].total_milliseconds,
+        )
+    )
+    cg.add(
+        heater_component.set_collision_detect(
+            config[CONF_TX_COLLISION_DETECT],
+            config[CONF_TX_COLLISION_MAX_RETRIES],
+            config[CONF_TX_COLLISION_BACKOFF].total_milliseconds,
+        )
+    )
+    cg.add(heater_component.set_frame_repair(config[CONF_RX_FRAME_REPAIR]))
+    cg.add(heater_component.set_task_stack_size(config[CONF_RX_STACK_SIZE]))
+    cg.add(
+        heater_component.set_task_affinity(
+            config[CONF_RX_TASK_CORE], config[CONF_RX_TASK_PRIORITY]
+        )
+    )
+    cg.add(
+        heater_component.set_fault_log_flush_policy(
+            config[CONF_FAULT_LOG_FLUSH_INTERVAL].total_milliseconds,
+            config[CONF_FAULT_LOG_FLUSH_BATCH],
+        )
+    )
+    cg.add(
+        heater_component.set_preferences_save_interval(
+            config[CONF_PREFERENCES_SAVE_INTERVAL].total_milliseconds
+        )
+    )
+    if config[CONF_DEFERRED_LOGGING]:
+        cg.add_define("USE_HWP_DEFERRED_LOGGING")
+    if config[CONF_ALLOC_TELEMETRY]:
+        cg.add_define("USE_HWP_ALLOC_TELEMETRY")
+    # The frame pool is sized for every heater of the configuration, defined once for all
+    if not CORE.data.setdefault("hwp", {}).get("bus_count_defined"):
+        bus_count = sum(
+            1 for conf in CORE.config.get("climate", []) if conf.get("platform") == "hwp"
+        )
+        cg.add_define("HWP_BUS_COUNT", bus_count)
+        CORE.data["hwp"]["bus_count_defined"] = True
 
     # Sensors
     for sensor_designator, (_name, _schema, registration_function, _filter_fn) in SENSORS.items():
@@ -587,6 +1125,15 @@ async def to_code(config):
         await registration_function(sensor_component, sensor_conf)
         cg.add(getattr(heater_component, f"set_{sensor_designator}_sensor")(sensor_component))
 
+    # Diagnostics
+    for sensor_designator, (_name, _schema, registration_function, _filter_fn) in DIAGNOSTICS.items():
+        if sensor_designator not in config[CONF_DIAGNOSTICS]:
+            continue
+        sensor_conf = config[CONF_DIAGNOSTICS][sensor_designator]
+        sensor_component = cg.new_Pvariable(sensor_conf[CONF_ID])
+        await registration_function(sensor_component, sensor_conf)
+        cg.add(getattr(heater_component, f"set_{sensor_designator}_sensor")(sensor_component))
+
     # Inputs (numbers/selects)
     for sensor_designator, (_name, schema_name, _schema_options, register_options) in INPUTS.items():
         if sensor_designator not in config[CONF_INPUT]:
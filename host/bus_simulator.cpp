@@ -0,0 +1,222 @@
+/**
+ * @file bus_simulator.cpp
+ * @brief Simulates days on the bus: controller, heater and this component sharing one wire.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sim_world.h"
+
+namespace esphome {
+namespace hwp {
+
+typedef struct {
+    uint32_t hours;
+    uint32_t command_interval_s; ///< Mean time between two commands
+    uint32_t seed;
+    bool adaptive_repeats;
+    bool collision_detect;
+    uint32_t min_confirmed_pct; ///< Exit with an error below this share of confirmed commands
+} sim_options_t;
+
+static uint32_t percentile(std::vector<uint32_t> values, size_t pct) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * pct / 100)];
+}
+
+static void print_usage(const char* name) {
+    printf("Usage: %s [--hours N] [--command-interval S] [--seed N] [--open-loop]\n"
+           "          [--no-collision-detect] [--min-confirmed PCT] [--log-level N]\n",
+        name);
+}
+
+static bool parse_options(int argc, char** argv, sim_options_t& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--hours" && has_value) {
+            options.hours = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--command-interval" && has_value) {
+            options.command_interval_s = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && has_value) {
+            options.seed = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--min-confirmed" && has_value) {
+            options.min_confirmed_pct = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--log-level" && has_value) {
+            host_log_level = atoi(argv[++i]);
+        } else if (arg == "--open-loop") {
+            options.adaptive_repeats = false;
+        } else if (arg == "--no-collision-detect") {
+            options.collision_detect = false;
+        } else {
+            return false;
+        }
+    }
+    return options.hours > 0 && options.command_interval_s > 0;
+}
+
+/**
+ * @class CommandSource
+ * @brief Sends a new setpoint at random intervals, like a user or an automation would.
+ *
+ * Every fourth command also changes a defrost setting, so both configuration frames are
+ * exercised.
+ */
+class CommandSource {
+  public:
+    CommandSource(SimWorld& world, uint32_t interval_s)
+        : world_(world), gap_(1.0 / (interval_s * 1000.0)) {
+        world.node().add_on_command_confirmed_callback(
+            [this](uint32_t, uint32_t elapsed_ms, uint8_t) {
+                this->outcomes_[COMMAND_CONFIRMED]++;
+                this->latencies_.push_back(elapsed_ms);
+            });
+        world.node().add_on_command_failed_callback([this](uint32_t, std::string reason, uint8_t) {
+            this->failures_[reason]++;
+        });
+        this->schedule();
+    }
+    uint32_t get_sent() const { return this->sent_; }
+    const std::vector<uint32_t>& get_latencies() const { return this->latencies_; }
+    const std::map<std::string, uint32_t>& get_failures() const { return this->failures_; }
+
+  protected:
+    SimWorld& world_;
+    std::exponential_distribution<double> gap_;
+    std::vector<uint32_t> latencies_;
+    std::map<std::string, uint32_t> failures_;
+    uint32_t outcomes_[COMMAND_ABANDONED + 1]{};
+    uint32_t count_{0};
+    uint32_t sent_{0};
+
+    void schedule() {
+        uint64_t gap_us = 1000 + static_cast<uint64_t>(this->gap_(this->world_.rng()) * 1000);
+        this->world_.at(this->world_.now_us() + gap_us, [this]() {
+            this->send();
+            this->schedule();
+        });
+    }
+    void send() {
+        HWPCall call = this->world_.node().instantiate_call();
+        call.set_target_temperature(static_cast<float>(20 + this->count_ % 10));
+        if (this->count_ % 4 == 3) call.d01_defrost_start = -static_cast<float>(this->count_ % 7);
+        this->count_++;
+        if (this->world_.node().control(call) != no_command_ticket) this->sent_++;
+    }
+};
+
+static int run(const sim_options_t& options) {
+    SimWorld world({options.seed, options.adaptive_repeats, options.collision_detect});
+    CommandSource commands(world, options.command_interval_s);
+    const uint64_t duration_ms = options.hours * 3600ULL * 1000;
+
+    auto wall_start = std::chrono::steady_clock::now();
+    world.run_for_ms(duration_ms);
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wall_start;
+    world.wire().update_stats();
+
+    uint32_t now = millis();
+    Bus& bus = world.node().bus();
+    const command_stats_t& stats = bus.get_command_tracker().get_stats();
+    printf("Simulated %u h in %.1fs (%.0f h/min), seed %u, %s repeats, collision detection %s, "
+           "a command every %us\n",
+        options.hours, wall.count(), options.hours * 60 / std::max(wall.count(), 0.001),
+        options.seed, options.adaptive_repeats ? "closed-loop" : "open-loop",
+        options.collision_detect ? "on" : "off", options.command_interval_s);
+    printf("Commands: %u issued, %u confirmed, %u failed, %u pending\n", stats.issued,
+        stats.confirmed, stats.failed,
+        static_cast<uint32_t>(bus.get_command_tracker().get_pending_count()));
+    for (const auto& failure : commands.get_failures()) {
+        printf("  %-10s %u\n", failure.first.c_str(), failure.second);
+    }
+    const std::vector<uint32_t>& latencies = commands.get_latencies();
+    uint64_t latency_sum = 0;
+    for (uint32_t latency : latencies) latency_sum += latency;
+    printf("Latency, queued to confirmed: avg %ums, p50 %ums, p95 %ums, max %ums\n",
+        latencies.empty() ? 0 : static_cast<uint32_t>(latency_sum / latencies.size()),
+        percentile(latencies, 50), percentile(latencies, 95), percentile(latencies, 100));
+    const tx_collision_stats_t& collisions = bus.get_tx_collision_stats();
+    printf("Bursts: %u sent, %u collisions detected, %u retried, %u frame(s) abandoned\n",
+        bus.get_tx_queue_stats().bursts, collisions.collisions, collisions.retries,
+        collisions.abandoned);
+    printf("Heater bursts interrupted: %u, wire time with overlapping talkers: %ums\n",
+        world.heater().get_collisions(),
+        static_cast<uint32_t>(world.wire().get_overlap_us() / 1000));
+    printf("Bus utilization   measured  scheduler estimate (last %us)\n",
+        (now - bus.get_scheduler().get_usage().since_ms) / 1000);
+    static const burst_origin_t origins[TALKER_COUNT] = {
+        BURST_HEATER, BURST_CONTROLLER, BURST_LOCAL};
+    uint64_t busy_total_us = 0;
+    for (size_t talker = 0; talker < TALKER_COUNT; talker++) {
+        uint64_t busy_us = world.wire().get_busy_us(static_cast<talker_t>(talker));
+        busy_total_us += busy_us;
+        printf("  %-14s %6.1f%%  %6.1f%%\n", talker_names[talker],
+            busy_us / (10.0f * duration_ms),
+            bus.get_scheduler().get_utilization(origins[talker], now));
+    }
+    printf("  %-14s %6.1f%%  %6.1f%%\n", "total", busy_total_us / (10.0f * duration_ms),
+        bus.get_scheduler().get_utilization(now));
+
+    if (!bus.is_tx_armed()) {
+        printf("FAIL: the transmitter never armed\n");
+        return EXIT_FAILURE;
+    }
+    if (stats.issued == 0 || stats.confirmed * 100 < stats.issued * options.min_confirmed_pct) {
+        printf("FAIL: less than %u%% of the commands were confirmed\n", options.min_confirmed_pct);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace hwp
+} // namespace esphome
+
+int main(int argc, char** argv) {
+    esphome::hwp::sim_options_t options{24, 300, 1, true, true, 0};
+    // the frame classes warn on every heater mode they do not fully understand yet
+    esphome::host_log_level = ESPHOME_LOG_LEVEL_ERROR;
+    if (!esphome::hwp::parse_options(argc, argv, options)) {
+        esphome::hwp::print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return esphome::hwp::run(options);
+}
@@ -0,0 +1,231 @@
+/**
+ * @file bus_test.cpp
+ * @brief Scenarios run against the real Bus and PoolHeater on the simulated wire.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sim_world.h"
+
+using namespace esphome;
+using namespace esphome::hwp;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                \
+            failures++;                                                                         \
+        }                                                                                       \
+    } while (0)
+
+/// @brief Long enough for the controller to be heard and the transmitter to arm.
+static constexpr uint32_t arm_time_ms = 2 * delay_between_controller_messages_ms;
+
+/**
+ * @brief Counts the outcomes reported through the command callbacks.
+ */
+typedef struct {
+    uint32_t confirmed;
+    uint32_t failed;
+} outcomes_t;
+
+static void track_outcomes(SimNode& node, outcomes_t& outcomes) {
+    node.add_on_command_confirmed_callback([&outcomes](uint32_t, uint32_t, uint8_t) {
+        outcomes.confirmed++;
+    });
+    node.add_on_command_failed_callback([&outcomes](uint32_t, std::string reason, uint8_t) {
+        printf("command failed: %s\n", reason.c_str());
+        outcomes.failed++;
+    });
+}
+
+/**
+ * @brief A heater reply in the group spacing that ends an open-loop burst is no collision.
+ *
+ * The heater waits a little more than a frame spacing of quiet before talking, so the echo of
+ * the command starts while this component still holds the bus for its trailing spacing.
+ */
+static void test_open_loop_gap() {
+    SimWorld world({1, false, true});
+    world.heater().set_idle_gap_ms(controler_frame_spacing_duration_ms + 50);
+    world.run_for_ms(arm_time_ms);
+    Bus& bus = world.node().bus();
+    CHECK(bus.is_tx_armed());
+
+    outcomes_t outcomes{};
+    track_outcomes(world.node(), outcomes);
+    uint32_t gap_bursts = world.heater().get_gap_bursts();
+    HWPCall call = world.node().instantiate_call();
+    call.set_target_temperature(25);
+    CHECK(world.node().control(call) != no_command_ticket);
+    world.run_for_ms(delay_between_controller_messages_ms);
+
+    CHECK(world.heater().get_gap_bursts() > gap_bursts);
+    CHECK(bus.get_tx_collision_stats().collisions == 0);
+    CHECK(bus.get_tx_queue_stats().bursts == 1);
+    CHECK(outcomes.confirmed == 1 && outcomes.failed == 0);
+}
+
+/**
+ * @brief The saved state is only rewritten when the settings change.
+ *
+ * The clock, the conditions and the bus timings change all day long; they must not wear the
+ * flash out on their own.
+ */
+static void test_preferences_writes() {
+    // the object id hash is 0 on the host
+    const uint32_t key = fnv1_hash("hwp_preferences");
+    SimWorld world({1, true, true});
+    world.run_for_ms(10 * 60 * 1000);
+    uint32_t writes = world.preferences().get_writes(key);
+    CHECK(writes > 0);
+
+    world.run_for_ms(24 * 60 * 60 * 1000);
+    CHECK(world.preferences().get_writes(key) == writes);
+    // but they are kept up to date when the component stops
+    world.node().on_shutdown();
+    CHECK(world.preferences().get_writes(key) == ++writes);
+    world.run_for_ms(default_preferences_save_interval_ms);
+    CHECK(world.preferences().get_writes(key) == writes);
+
+    outcomes_t outcomes{};
+    track_outcomes(world.node(), outcomes);
+    HWPCall call = world.node().instantiate_call();
+    call.set_target_temperature(25);
+    CHECK(world.node().control(call) != no_command_ticket);
+    for (int i = 0; i < 100 && outcomes.confirmed == 0; i++) world.run_for_ms(100);
+    CHECK(outcomes.confirmed == 1);
+    // the wall controller puts its own setpoint back within a minute, save before it does
+    world.node().update();
+    CHECK(world.preferences().get_writes(key) == ++writes);
+}
+
+/**
+ * @brief No command is built on a frame restored from flash.
+ *
+ * The heater may have been changed while the component was down; a command built on the
+ * saved copy would silently undo that change.
+ */
+static void test_restored_command() {
+    SimWorld before({1, true, true});
+    before.run_for_ms(arm_time_ms);
+    before.node().on_shutdown();
+
+    // the first bus stays registered with the decode worker, so both worlds live to the end
+    SimWorld after({2, true, true}, &before.preferences());
+    SimNode& node = after.node();
+    CHECK(node.bus().get_registry().restored_count() > 0);
+    outcomes_t outcomes{};
+    track_outcomes(node, outcomes);
+    CHECK(node.data().target_temperature.has_value());
+    float restored_target = node.data().target_temperature.value_or(0);
+    CHECK(restored_target != 25);
+    HWPCall call = node.instantiate_call();
+    call.set_target_temperature(25);
+    CHECK(node.control(call) == no_command_ticket);
+    CHECK(node.data().target_temperature.value_or(0) == restored_target);
+
+    after.run_for_ms(arm_time_ms);
+    CHECK(node.bus().get_registry().restored_count() == 0);
+    CHECK(node.control(call) != no_command_ticket);
+    after.run_for_ms(10 * 1000);
+    CHECK(outcomes.confirmed == 1 && outcomes.failed == 0);
+}
+
+/**
+ * @brief A command merged into a newer one before it was sent is confirmed along with it.
+ */
+static void test_merged_commands() {
+    SimWorld world({1, true, true});
+    outcomes_t outcomes{};
+    track_outcomes(world.node(), outcomes);
+    std::vector<uint32_t> confirmed;
+    world.node().add_on_command_confirmed_callback(
+        [&confirmed](uint32_t ticket, uint32_t, uint8_t frame_type) {
+            CHECK(frame_type == FrameConf1::FRAME_ID_CONF_1);
+            confirmed.push_back(ticket);
+        });
+    // the first controller burst has not been heard yet, the frames wait in the queue
+    world.run_for_ms(heater_config_period_ms);
+    HWPCall first = world.node().instantiate_call();
+    first.set_target_temperature(25);
+    command_ticket_t first_ticket = world.node().control(first);
+    CHECK(first_ticket != no_command_ticket);
+    CHECK(world.node().get_last_command_ticket() == first_ticket);
+    HWPCall second = world.node().instantiate_call();
+    second.set_target_temperature(26);
+    command_ticket_t second_ticket = world.node().control(second);
+    CHECK(second_ticket != no_command_ticket && second_ticket != first_ticket);
+    CHECK(world.node().get_last_command_ticket() == second_ticket);
+    CHECK(world.node().bus().get_tx_queue_stats().merged == 1);
+
+    world.run_for_ms(arm_time_ms);
+    CHECK(outcomes.confirmed == 2 && outcomes.failed == 0);
+    CHECK(confirmed.size() == 2);
+}
+
+typedef struct {
+    const char* name;
+    void (*run)();
+} scenario_t;
+
+// The buses register with the decode worker for good: each scenario runs in its own process.
+static const scenario_t scenarios[] = {
+    {"open_loop_gap", test_open_loop_gap},
+    {"preferences_writes", test_preferences_writes},
+    {"restored_command", test_restored_command},
+    {"merged_commands", test_merged_commands},
+};
+
+int main(int argc, char** argv) {
+    host_log_level = ESPHOME_LOG_LEVEL_ERROR;
+    for (const scenario_t& scenario : scenarios) {
+        if (argc != 2 || strcmp(argv[1], scenario.name) != 0) continue;
+        scenario.run();
+        if (failures != 0) {
+            printf("%s: %d check(s) failed\n", scenario.name, failures);
+            return EXIT_FAILURE;
+        }
+        printf("%s: all checks passed\n", scenario.name);
+        return EXIT_SUCCESS;
+    }
+    printf("Usage: %s SCENARIO\n", argv[0]);
+    for (const scenario_t& scenario : scenarios) printf("  %s\n", scenario.name);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,28 @@
+// Host stand-in for the ESP-IDF RMT driver: only the pulse item layout and the config type
+// held by the bus are used.
+#pragma once
+
+#include <cstdint>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+typedef struct {
+    union {
+        struct {
+            uint32_t duration0 : 15;
+            uint32_t level0 : 1;
+            uint32_t duration1 : 15;
+            uint32_t level1 : 1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+// Only held by the bus, the RMT peripheral is not used any more
+typedef struct {
+    uint8_t channel;
+} rmt_config_t;
@@ -0,0 +1,13 @@
+// Host stand-in for the ESP-IDF heap capabilities API.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_8BIT 4
+#define MALLOC_CAP_INTERNAL 2048
+#define MALLOC_CAP_DEFAULT 4096
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
@@ -0,0 +1,6 @@
+// Host stand-in for the ESP-IDF random number generator.
+#pragma once
+
+#include <cstdint>
+
+uint32_t esp_random();
@@ -0,0 +1,14 @@
+// Host stand-in for the ESPHome binary_sensor entity.
+#pragma once
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace binary_sensor {
+class BinarySensor : public EntityBase {
+  public:
+    void publish_state(bool state) { this->state = state; }
+    bool state{};
+};
+} // namespace binary_sensor
+} // namespace esphome
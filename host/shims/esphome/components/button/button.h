@@ -0,0 +1,13 @@
+// Host stand-in for the ESPHome button entity.
+#pragma once
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace button {
+class Button : public EntityBase {
+  protected:
+    virtual void press_action() = 0;
+};
+} // namespace button
+} // namespace esphome
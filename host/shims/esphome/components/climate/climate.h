@@ -0,0 +1,80 @@
+// Host stand-in for the ESPHome climate entity, enough for the frame classes to build.
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#include "esphome/components/climate/climate_mode.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/text_sensor/text_sensor.h"
+#include "esphome/core/component.h"
+#include "esphome/core/gpio.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/core/optional.h"
+
+namespace esphome {
+namespace climate {
+
+class Climate;
+
+class ClimateTraits {
+  public:
+    void set_visual_min_temperature(float) {}
+    void set_visual_max_temperature(float) {}
+    void set_visual_temperature_step(float) {}
+    void set_supported_custom_fan_modes(std::initializer_list<const char*>) {}
+    void set_supported_modes(std::initializer_list<ClimateMode>) {}
+    void set_supported_fan_modes(std::initializer_list<ClimateFanMode>) {}
+};
+
+class ClimateCall {
+  public:
+    explicit ClimateCall(Climate* parent) : parent_(parent) {}
+    ClimateCall& set_mode(ClimateMode mode) {
+        this->mode_ = mode;
+        return *this;
+    }
+    ClimateCall& set_target_temperature(float target_temperature) {
+        this->target_temperature_ = target_temperature;
+        return *this;
+    }
+    ClimateCall& set_fan_mode(ClimateFanMode fan_mode) {
+        this->fan_mode_ = fan_mode;
+        return *this;
+    }
+    const optional<ClimateMode>& get_mode() const { return this->mode_; }
+    const optional<float>& get_target_temperature() const { return this->target_temperature_; }
+    const optional<ClimateFanMode>& get_fan_mode() const { return this->fan_mode_; }
+    std::string get_custom_fan_mode() const { return ""; }
+
+  protected:
+    Climate* parent_;
+    optional<ClimateMode> mode_;
+    optional<float> target_temperature_;
+    optional<ClimateFanMode> fan_mode_;
+};
+
+class Climate : public EntityBase {
+  public:
+    virtual ~Climate() = default;
+    void publish_state() {}
+    virtual ClimateTraits traits() = 0;
+    virtual void control(const ClimateCall& call) = 0;
+    ClimateMode mode{CLIMATE_MODE_OFF};
+    ClimateAction action{CLIMATE_ACTION_OFF};
+    optional<ClimateFanMode> fan_mode;
+    float current_temperature{NAN};
+    float target_temperature{NAN};
+
+  protected:
+    void restore_state_() {}
+    void dump_traits_(const char* /*tag*/) {}
+};
+
+} // namespace climate
+} // namespace esphome
@@ -0,0 +1,33 @@
+// Host stand-in for the ESPHome climate enums.
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace climate {
+enum ClimateMode : uint8_t {
+    CLIMATE_MODE_OFF = 0,
+    CLIMATE_MODE_HEAT_COOL,
+    CLIMATE_MODE_COOL,
+    CLIMATE_MODE_HEAT,
+    CLIMATE_MODE_FAN_ONLY,
+    CLIMATE_MODE_DRY,
+    CLIMATE_MODE_AUTO,
+};
+enum ClimateAction : uint8_t {
+    CLIMATE_ACTION_OFF = 0,
+    CLIMATE_ACTION_COOLING = 2,
+    CLIMATE_ACTION_HEATING = 3,
+    CLIMATE_ACTION_IDLE = 4,
+};
+enum ClimateFanMode : uint8_t {
+    CLIMATE_FAN_ON = 0,
+    CLIMATE_FAN_OFF,
+    CLIMATE_FAN_AUTO,
+    CLIMATE_FAN_LOW,
+    CLIMATE_FAN_MEDIUM,
+    CLIMATE_FAN_HIGH,
+};
+const char* climate_mode_to_string(ClimateMode mode);
+} // namespace climate
+} // namespace esphome
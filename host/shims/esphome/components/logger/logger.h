@@ -0,0 +1,11 @@
+// Host stand-in for the ESPHome logger component.
+#pragma once
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace logger {
+class Logger {};
+extern Logger* global_logger;
+} // namespace logger
+} // namespace esphome
@@ -0,0 +1,14 @@
+// Host stand-in for the ESPHome number entity.
+#pragma once
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace number {
+class Number : public EntityBase {
+  public:
+    void publish_state(float state) { this->state = state; }
+    float state{};
+};
+} // namespace number
+} // namespace esphome
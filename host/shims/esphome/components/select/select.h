@@ -0,0 +1,16 @@
+// Host stand-in for the ESPHome select entity.
+#pragma once
+
+#include <string>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace select {
+class Select : public EntityBase {
+  public:
+    void publish_state(const std::string& state) { this->state = state; }
+    std::string state;
+};
+} // namespace select
+} // namespace esphome
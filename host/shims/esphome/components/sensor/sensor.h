@@ -0,0 +1,14 @@
+// Host stand-in for the ESPHome sensor entity.
+#pragma once
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace sensor {
+class Sensor : public EntityBase {
+  public:
+    void publish_state(float state) { this->state = state; }
+    float state{};
+};
+} // namespace sensor
+} // namespace esphome
@@ -0,0 +1,16 @@
+// Host stand-in for the ESPHome text_sensor entity.
+#pragma once
+
+#include <string>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace text_sensor {
+class TextSensor : public EntityBase {
+  public:
+    void publish_state(const std::string& state) { this->state = state; }
+    std::string state;
+};
+} // namespace text_sensor
+} // namespace esphome
@@ -0,0 +1,2 @@
+// Host stand-in for the ESPHome watchdog component, unused on the host.
+#pragma once
@@ -0,0 +1,7 @@
+// Host stand-in for the ESPHome application header.
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
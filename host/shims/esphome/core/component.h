@@ -0,0 +1,44 @@
+// Host stand-in for the ESPHome component base classes.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "esphome/core/optional.h"
+#include "esphome/core/preferences.h"
+
+namespace esphome {
+
+class Component {
+  public:
+    virtual ~Component() = default;
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual void dump_config() {}
+    virtual void on_shutdown() {}
+    void status_set_warning(const char* message = nullptr);
+    void status_clear_warning();
+    void status_momentary_warning(const std::string& name, uint32_t length = 5000);
+    void status_momentary_error(const std::string& name, uint32_t length = 5000);
+};
+
+class PollingComponent : public Component {
+  public:
+    PollingComponent() = default;
+    explicit PollingComponent(uint32_t update_interval) : update_interval_(update_interval) {}
+    virtual void update() = 0;
+    void set_update_interval(uint32_t update_interval) { this->update_interval_ = update_interval; }
+    uint32_t get_update_interval() const { return this->update_interval_; }
+
+  protected:
+    uint32_t update_interval_{0};
+};
+
+class EntityBase {
+  public:
+    uint32_t get_object_id_hash() { return 0; }
+    const char* get_name() const { return ""; }
+};
+
+} // namespace esphome
@@ -0,0 +1,2 @@
+// Host stand-in for the generated ESPHome defines: none of the optional features are enabled.
+#pragma once
@@ -0,0 +1,58 @@
+// Host stand-in for the ESPHome GPIO pins, implemented by the simulated wire.
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace gpio {
+enum Flags : uint8_t {
+    FLAG_NONE = 0,
+    FLAG_INPUT = 1,
+    FLAG_OUTPUT = 2,
+    FLAG_OPEN_DRAIN = 4,
+    FLAG_PULLUP = 8,
+    FLAG_PULLDOWN = 16,
+};
+inline Flags operator|(Flags a, Flags b) { return Flags(uint8_t(a) | uint8_t(b)); }
+
+enum InterruptType : uint8_t {
+    INTERRUPT_RISING_EDGE = 1,
+    INTERRUPT_FALLING_EDGE = 2,
+    INTERRUPT_ANY_EDGE = 3,
+};
+} // namespace gpio
+
+class InternalGPIOPin;
+
+/// @brief Copy of a pin usable from an ISR, reads go back to the pin it was made from.
+class ISRInternalGPIOPin {
+  public:
+    ISRInternalGPIOPin() = default;
+    explicit ISRInternalGPIOPin(InternalGPIOPin* pin) : pin_(pin) {}
+    bool digital_read();
+
+  protected:
+    InternalGPIOPin* pin_{nullptr};
+};
+
+class InternalGPIOPin {
+  public:
+    virtual ~InternalGPIOPin() = default;
+    virtual void pin_mode(gpio::Flags flags) = 0;
+    virtual bool digital_read() = 0;
+    virtual void digital_write(bool value) = 0;
+    virtual uint8_t get_pin() const = 0;
+    virtual ISRInternalGPIOPin to_isr() const = 0;
+    template <typename T>
+    void attach_interrupt(void (*func)(T*), T* arg, gpio::InterruptType type) const {
+        this->attach_interrupt(reinterpret_cast<void (*)(void*)>(func), arg, type);
+    }
+
+  protected:
+    virtual void attach_interrupt(
+        void (*func)(void*), void* arg, gpio::InterruptType type) const = 0;
+};
+
+inline bool ISRInternalGPIOPin::digital_read() { return this->pin_->digital_read(); }
+
+} // namespace esphome
@@ -0,0 +1,17 @@
+// Host stand-in for the ESPHome HAL, the time comes from the virtual clock.
+#pragma once
+
+#include <cstdint>
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+namespace esphome {
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+/// Always 0 on the host: the ISR takes no virtual time.
+uint32_t arch_get_cpu_cycle_count();
+uint32_t arch_get_cpu_freq_hz();
+} // namespace esphome
@@ -0,0 +1,32 @@
+// Host stand-in for the ESPHome helpers used by the frame classes.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/optional.h"
+
+namespace esphome {
+uint32_t fnv1_hash(const std::string& str);
+uint32_t random_uint32();
+std::string value_accuracy_to_string(float value, int8_t accuracy_decimals);
+
+template <typename... X> class CallbackManager;
+template <typename... Ts> class CallbackManager<void(Ts...)> {
+  public:
+    void add(std::function<void(Ts...)>&& callback) {
+        this->callbacks_.push_back(std::move(callback));
+    }
+    void call(Ts... args) {
+        for (auto& callback : this->callbacks_) callback(args...);
+    }
+    size_t size() const { return this->callbacks_.size(); }
+
+  protected:
+    std::vector<std::function<void(Ts...)>> callbacks_;
+};
+} // namespace esphome
@@ -0,0 +1,2 @@
+// Host stand-in for the ESPHome macros, none of which the component uses.
+#pragma once
@@ -0,0 +1,25 @@
+// Host stand-in for the ESPHome optional, backed by std::optional.
+#pragma once
+
+#include <optional>
+#include <type_traits>
+
+namespace esphome {
+
+template <typename T> class optional : public std::optional<T> {
+  public:
+    using std::optional<T>::optional;
+    optional() = default;
+    optional(std::nullopt_t) {}
+    template <typename U,
+        typename = std::enable_if_t<std::is_constructible<T, const U&>::value>>
+    optional(const optional<U>& other) {
+        if (other.has_value()) this->emplace(*other);
+    }
+};
+
+using std::nullopt;
+
+template <typename T> optional<T> make_optional(const T& value) { return optional<T>(value); }
+
+} // namespace esphome
@@ -0,0 +1,67 @@
+// Host stand-in for the ESPHome preferences: an in-memory flash that counts the writes.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace esphome {
+
+class ESPPreferences;
+
+class ESPPreferenceObject {
+  public:
+    ESPPreferenceObject() = default;
+    ESPPreferenceObject(ESPPreferences* preferences, uint32_t key)
+        : preferences_(preferences), key_(key) {}
+    template <typename T> bool save(const T* src);
+    template <typename T> bool load(T* dest);
+
+  protected:
+    ESPPreferences* preferences_{nullptr};
+    uint32_t key_{0};
+};
+
+class ESPPreferences {
+  public:
+    template <typename T>
+    ESPPreferenceObject make_preference(uint32_t type, bool /*in_flash*/ = false) {
+        return {this, type};
+    }
+    bool sync() { return true; }
+
+    bool save(uint32_t key, const void* data, size_t size) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        this->data_[key].assign(bytes, bytes + size);
+        this->writes_[key]++;
+        return true;
+    }
+    bool load(uint32_t key, void* data, size_t size) const {
+        auto it = this->data_.find(key);
+        if (it == this->data_.end() || it->second.size() != size) return false;
+        memcpy(data, it->second.data(), size);
+        return true;
+    }
+    /// @brief Number of times a preference was written, as a flash wear indicator.
+    uint32_t get_writes(uint32_t key) const {
+        auto it = this->writes_.find(key);
+        return it == this->writes_.end() ? 0 : it->second;
+    }
+
+  protected:
+    std::map<uint32_t, std::vector<uint8_t>> data_;
+    std::map<uint32_t, uint32_t> writes_;
+};
+
+template <typename T> bool ESPPreferenceObject::save(const T* src) {
+    return this->preferences_ != nullptr && this->preferences_->save(this->key_, src, sizeof(T));
+}
+template <typename T> bool ESPPreferenceObject::load(T* dest) {
+    return this->preferences_ != nullptr && this->preferences_->load(this->key_, dest, sizeof(T));
+}
+
+extern ESPPreferences* global_preferences;
+
+} // namespace esphome
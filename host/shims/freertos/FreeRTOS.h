@@ -0,0 +1,23 @@
+// Host stand-in for the FreeRTOS types. The simulation is single threaded.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+typedef int BaseType_t;
+#define portBASE_TYPE BaseType_t
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void* QueueHandle_t;
+typedef void* QueueSetHandle_t;
+typedef void* QueueSetMemberHandle_t;
+typedef void* RingbufHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(x) (x)
+#define portYIELD_FROM_ISR(...)
@@ -0,0 +1,4 @@
+// Host stand-in for the FreeRTOS queues, unused on the host.
+#pragma once
+
+#include "freertos/FreeRTOS.h"
@@ -0,0 +1,18 @@
+// Host stand-in for the ESP-IDF ring buffers, only the byte buffers used by the bus ISR.
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT,
+    RINGBUF_TYPE_ALLOWSPLIT,
+    RINGBUF_TYPE_BYTEBUF,
+} RingbufferType_t;
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type);
+BaseType_t xRingbufferSendFromISR(
+    RingbufHandle_t ring, const void* item, size_t size, BaseType_t* woken);
+void* xRingbufferReceiveUpTo(
+    RingbufHandle_t ring, size_t* size, TickType_t ticks, size_t max_size);
+void vRingbufferReturnItem(RingbufHandle_t ring, void* item);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t ring);
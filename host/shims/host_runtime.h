@@ -0,0 +1,76 @@
+/**
+ * @file host_runtime.h
+ * @brief Hooks into the host stand-ins of the ESPHome and ESP-IDF runtime.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "virtual_clock.h"
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @brief The clock behind millis(), micros() and esp_timer_get_time() on the host.
+ */
+VirtualClock& host_clock();
+
+/**
+ * @brief Seeds the generator behind random_uint32() and esp_random().
+ */
+void host_seed_random(uint32_t seed);
+
+/**
+ * @brief Gets the deadline of the earliest armed esp_timer.
+ * @return false If no timer is armed.
+ */
+bool host_next_timer_us(uint64_t* due_us);
+
+/**
+ * @brief Runs the callbacks of the esp_timers due at the current time.
+ */
+void host_run_timers();
+
+/**
+ * @brief Tells whether a task was notified since the last call, and clears it.
+ *
+ * The decode worker task never runs on the host: the simulation services the buses itself
+ * when this returns true.
+ */
+bool host_take_notification();
+void host_notify();
+
+} // namespace hwp
+} // namespace esphome
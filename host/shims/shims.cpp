@@ -0,0 +1,311 @@
+/**
+ * @file shims.cpp
+ * @brief Host definitions of the ESPHome and ESP-IDF functions the component calls.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esphome/components/climate/climate_mode.h"
+#include "esphome/components/logger/logger.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "host_runtime.h"
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool armed;
+    uint64_t due_us;
+};
+
+namespace esphome {
+namespace hwp {
+
+static VirtualClock clock_;
+static std::mt19937 random_;
+static std::vector<esp_timer*> timers_;
+static bool notified_ = false;
+
+VirtualClock& host_clock() { return clock_; }
+void host_seed_random(uint32_t seed) { random_.seed(seed); }
+
+bool host_next_timer_us(uint64_t* due_us) {
+    bool found = false;
+    for (const esp_timer* timer : timers_) {
+        if (!timer->armed || (found && timer->due_us >= *due_us)) continue;
+        *due_us = timer->due_us;
+        found = true;
+    }
+    return found;
+}
+
+void host_run_timers() {
+    uint64_t now = clock_.now_us();
+    bool fired = true;
+    // a callback may arm a timer again, for now or for later
+    while (fired) {
+        fired = false;
+        for (esp_timer* timer : timers_) {
+            if (!timer->armed || timer->due_us > now) continue;
+            timer->armed = false;
+            timer->callback(timer->arg);
+            fired = true;
+        }
+    }
+}
+
+bool host_take_notification() {
+    bool notified = notified_;
+    notified_ = false;
+    return notified;
+}
+
+void host_notify() { notified_ = true; }
+
+} // namespace hwp
+
+int host_log_level = ESPHOME_LOG_LEVEL_WARN;
+
+void esp_log_printf_(int level, const char* tag, int /*line*/, const char* format, ...) {
+    if (level > host_log_level) return;
+    static const char levels[] = "?EWICDVV";
+    printf("[%10.3f][%c][%s] ", hwp::host_clock().now_us() / 1e6, levels[level & 7], tag);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+// Left empty so BaseFrame::log_active() skips the formatting of the frame dumps
+namespace logger {
+Logger* global_logger = nullptr;
+} // namespace logger
+
+ESPPreferences* global_preferences = nullptr;
+
+uint32_t millis() { return hwp::host_clock().millis(); }
+uint32_t micros() { return static_cast<uint32_t>(hwp::host_clock().now_us()); }
+void delay(uint32_t ms) { hwp::host_clock().advance_ms(ms); }
+void delayMicroseconds(uint32_t us) { hwp::host_clock().advance_us(us); }
+uint32_t arch_get_cpu_cycle_count() { return 0; }
+uint32_t arch_get_cpu_freq_hz() { return 240000000; }
+
+uint32_t fnv1_hash(const std::string& str) {
+    uint32_t hash = 2166136261UL;
+    for (char c : str) {
+        hash *= 16777619UL;
+        hash ^= static_cast<uint8_t>(c);
+    }
+    return hash;
+}
+
+uint32_t random_uint32() { return hwp::random_(); }
+
+std::string value_accuracy_to_string(float value, int8_t accuracy_decimals) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", accuracy_decimals, value);
+    return buffer;
+}
+
+void Component::status_set_warning(const char* /*message*/) {}
+void Component::status_clear_warning() {}
+void Component::status_momentary_warning(const std::string& /*name*/, uint32_t /*length*/) {}
+void Component::status_momentary_error(const std::string& /*name*/, uint32_t /*length*/) {}
+
+namespace climate {
+const char* climate_mode_to_string(ClimateMode mode) {
+    switch (mode) {
+    case CLIMATE_MODE_OFF:
+        return "OFF";
+    case CLIMATE_MODE_HEAT_COOL:
+        return "HEAT_COOL";
+    case CLIMATE_MODE_COOL:
+        return "COOL";
+    case CLIMATE_MODE_HEAT:
+        return "HEAT";
+    case CLIMATE_MODE_FAN_ONLY:
+        return "FAN_ONLY";
+    case CLIMATE_MODE_DRY:
+        return "DRY";
+    case CLIMATE_MODE_AUTO:
+        return "AUTO";
+    default:
+        return "UNKNOWN";
+    }
+}
+} // namespace climate
+
+} // namespace esphome
+
+int64_t esp_timer_get_time() {
+    return static_cast<int64_t>(esphome::hwp::host_clock().now_us());
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    *handle = new esp_timer{args->callback, args->arg, false, 0};
+    esphome::hwp::timers_.push_back(*handle);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = true;
+    timer->due_us = esphome::hwp::host_clock().now_us() + timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    auto& timers = esphome::hwp::timers_;
+    timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+    delete timer;
+    return ESP_OK;
+}
+
+uint32_t esp_random() { return esphome::random_uint32(); }
+
+// Tasks never run on the host: a notification only tells the simulation to service the buses
+static int task_;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t /*task*/, const char* /*name*/,
+    uint32_t /*stack_size*/, void* /*arg*/, UBaseType_t /*priority*/, TaskHandle_t* handle,
+    BaseType_t /*core*/) {
+    *handle = &task_;
+    return pdPASS;
+}
+void vTaskDelete(TaskHandle_t /*task*/) {}
+TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t /*task*/) { return 0; }
+BaseType_t xTaskNotifyGive(TaskHandle_t /*task*/) {
+    esphome::hwp::host_notify();
+    return pdPASS;
+}
+BaseType_t xTaskNotify(TaskHandle_t /*task*/, uint32_t /*value*/, eNotifyAction /*action*/) {
+    esphome::hwp::host_notify();
+    return pdPASS;
+}
+BaseType_t xTaskNotifyFromISR(
+    TaskHandle_t /*task*/, uint32_t /*value*/, eNotifyAction /*action*/, BaseType_t* woken) {
+    esphome::hwp::host_notify();
+    *woken = pdTRUE;
+    return pdPASS;
+}
+BaseType_t xTaskNotifyWait(uint32_t /*clear_on_entry*/, uint32_t /*clear_on_exit*/,
+    uint32_t* value, TickType_t /*ticks*/) {
+    *value = 0;
+    return esphome::hwp::host_take_notification() ? pdTRUE : pdFALSE;
+}
+
+/// @brief Byte ring buffer: one contiguous chunk at a time is lent to the reader.
+struct HostRingbuf {
+    std::vector<uint8_t> data;
+    size_t head;
+    size_t used;
+    size_t lent;
+};
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t /*type*/) {
+    return new HostRingbuf{std::vector<uint8_t>(size), 0, 0, 0};
+}
+
+BaseType_t xRingbufferSendFromISR(
+    RingbufHandle_t handle, const void* item, size_t size, BaseType_t* /*woken*/) {
+    auto* ring = static_cast<HostRingbuf*>(handle);
+    size_t capacity = ring->data.size();
+    if (size > capacity - ring->used) return pdFALSE;
+    const auto* bytes = static_cast<const uint8_t*>(item);
+    size_t tail = (ring->head + ring->used) % capacity;
+    size_t first = std::min(size, capacity - tail);
+    memcpy(&ring->data[tail], bytes, first);
+    memcpy(&ring->data[0], bytes + first, size - first);
+    ring->used += size;
+    return pdTRUE;
+}
+
+void* xRingbufferReceiveUpTo(
+    RingbufHandle_t handle, size_t* size, TickType_t /*ticks*/, size_t max_size) {
+    auto* ring = static_cast<HostRingbuf*>(handle);
+    if (ring->used == 0 || ring->lent != 0) return nullptr;
+    ring->lent = std::min({ring->used, ring->data.size() - ring->head, max_size});
+    *size = ring->lent;
+    return &ring->data[ring->head];
+}
+
+void vRingbufferReturnItem(RingbufHandle_t handle, void* /*item*/) {
+    auto* ring = static_cast<HostRingbuf*>(handle);
+    ring->head = (ring->head + ring->lent) % ring->data.size();
+    ring->used -= ring->lent;
+    ring->lent = 0;
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t handle) {
+    auto* ring = static_cast<HostRingbuf*>(handle);
+    return ring->data.size() - ring->used;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new bool(false); }
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete static_cast<bool*>(semaphore); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    *static_cast<bool*>(semaphore) = true;
+    return pdTRUE;
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t /*ticks*/) {
+    bool* given = static_cast<bool*>(semaphore);
+    if (!*given) return pdFALSE;
+    *given = false;
+    return pdTRUE;
+}
+
+size_t heap_caps_get_free_size(uint32_t /*caps*/) { return 0; }
+size_t heap_caps_get_largest_free_block(uint32_t /*caps*/) { return 0; }
+size_t heap_caps_get_minimum_free_size(uint32_t /*caps*/) { return 0; }
@@ -0,0 +1,686 @@
+/**
+ * @file sim_world.h
+ * @brief The wire, the wall controller and the heater, around the real PoolHeater component.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "DecodeWorker.h"
+#include "Decoder.h"
+#include "FrameConf3.h"
+#include "FrameTypes.h"
+#include "PoolHeater.h"
+#include "TxEngine.h"
+#include "host_runtime.h"
+
+namespace esphome {
+namespace hwp {
+
+static constexpr uint64_t sim_never_us = UINT64_MAX;
+
+// Same values as the defaults of climate.py
+static constexpr uint8_t sim_repeat_group = 2;
+static constexpr uint32_t sim_confirm_window_ms = 2500;
+static constexpr uint8_t sim_collision_max_retries = 3;
+static constexpr uint32_t sim_collision_backoff_ms = 500;
+
+static constexpr uint32_t sim_loop_interval_ms = 16; ///< Period of the ESPHome main loop
+static constexpr uint32_t sim_idle_loop_interval_ms = 1000; ///< Same, with nothing new to handle
+static constexpr uint32_t sim_update_interval_ms = 60000;
+static constexpr uint32_t heater_status_period_ms = 10000;
+static constexpr uint32_t heater_config_period_ms = 20000;
+static constexpr uint32_t heater_echo_delay_ms = 300;
+static constexpr uint32_t heater_idle_gap_ms = 200; ///< Quiet time the heater waits for
+static constexpr uint32_t controller_jitter_ms = 150;
+static constexpr uint8_t config_types[] = {FrameConf1::FRAME_ID_CONF_1,
+    FrameConf2::FRAME_ID_CONF_2, 0x83, 0x84, 0x85, 0x86};
+
+/**
+ * @brief Talkers sharing the wire, in the order of the report.
+ */
+typedef enum { TALKER_HEATER, TALKER_CONTROLLER, TALKER_LOCAL, TALKER_COUNT } talker_t;
+static const char* const talker_names[TALKER_COUNT] = {"heater", "controller", "local"};
+
+inline hp_packetdata_t make_packet(uint8_t type, uint8_t fill) {
+    hp_packetdata_t packet{};
+    packet.data_len = frame_data_length;
+    packet.data[0] = type;
+    // spread the bytes: with a regular fill, the first nine bytes of many frames also pass
+    // as a short frame and the decoders stop there
+    for (size_t i = 1; i < frame_data_length - 1; i++) {
+        packet.data[i] = static_cast<uint8_t>(fill + i * 29);
+    }
+    packet.set_checksum();
+    return packet;
+}
+
+/**
+ * @brief The configuration frames of the heater, with setpoint limits of 15 to 33°C.
+ */
+inline std::vector<hp_packetdata_t> make_config_packets() {
+    std::vector<hp_packetdata_t> packets;
+    for (uint8_t type : config_types) {
+        packets.push_back(make_packet(type, type));
+    }
+    hp_packetdata_t& packet = packets[2];
+    auto limits = packet.as_type<conf_3_t>();
+    limits.r08_min_cool_setpoint = 15.0f;
+    limits.r09_max_cooling_setpoint = 33.0f;
+    limits.r10_min_heating_setpoint = 15.0f;
+    limits.r11_max_heating_setpoint = 33.0f;
+    memcpy(packet.data + 1, &limits, sizeof(limits));
+    packet.set_checksum();
+    return packets;
+}
+
+/**
+ * @brief Appends the levels of a burst, the way Bus::send_frame() builds them.
+ */
+inline void append_burst(TxEngine& engine, const std::vector<hp_packetdata_t>& packets) {
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (i > 0) {
+            engine.append_level(false, bit_low_duration_ms);
+            engine.append_level(true, controler_frame_spacing_duration_ms);
+        }
+        engine.append_level(false, frame_heading_low_duration_ms);
+        engine.append_level(true, frame_heading_high_duration_ms);
+        for (size_t byte = 0; byte < packets[i].data_len; byte++) {
+            for (uint8_t bit = 0; bit <= 7; bit++) {
+                engine.append_level(false, bit_low_duration_ms);
+                engine.append_level(true, get_bit(packets[i].data[byte], bit)
+                                              ? bit_long_high_duration_ms
+                                              : bit_short_high_duration_ms);
+            }
+        }
+    }
+    engine.append_level(false, bit_low_duration_ms);
+}
+
+/**
+ * @brief Told about each change of the line level.
+ */
+class WireListener {
+  public:
+    virtual ~WireListener() = default;
+    virtual void on_line(bool low, uint64_t now_us) = 0;
+};
+
+/**
+ * @class VirtualWire
+ * @brief The open-drain line: low as long as one talker pulls it low.
+ *
+ * It also accounts the time each talker holds the bus, from the start to the end of its
+ * bursts, and the time several talkers held it together.
+ */
+class VirtualWire {
+  public:
+    void add_listener(WireListener* listener) { this->listeners_.push_back(listener); }
+    void remove_listener(WireListener* listener) {
+        this->listeners_.erase(
+            std::remove(this->listeners_.begin(), this->listeners_.end(), listener),
+            this->listeners_.end());
+    }
+    bool is_low() const { return this->low_count_ > 0; }
+    bool is_driving(talker_t talker) const { return this->driving_[talker]; }
+    bool is_active(talker_t talker) const { return this->active_[talker]; }
+    uint64_t get_last_rise_us() const { return this->last_rise_us_; }
+
+    void drive(talker_t talker, bool low) {
+        if (this->driving_[talker] == low) return;
+        bool was_low = this->is_low();
+        this->driving_[talker] = low;
+        this->low_count_ += low ? 1 : -1;
+        if (this->is_low() == was_low) return;
+        uint64_t now = host_clock().now_us();
+        if (!low) this->last_rise_us_ = now;
+        for (WireListener* listener : this->listeners_) listener->on_line(low, now);
+    }
+    void set_active(talker_t talker, bool active) {
+        this->update_stats();
+        this->active_[talker] = active;
+    }
+
+    /// @brief Accounts the bus time up to now, call before reading the totals.
+    void update_stats() {
+        uint64_t now = host_clock().now_us();
+        uint64_t elapsed = now - this->accounted_us_;
+        size_t talking = 0;
+        for (size_t talker = 0; talker < TALKER_COUNT; talker++) {
+            if (!this->active_[talker]) continue;
+            this->busy_us_[talker] += elapsed;
+            talking++;
+        }
+        if (talking > 1) this->overlap_us_ += elapsed;
+        this->accounted_us_ = now;
+    }
+    uint64_t get_busy_us(talker_t talker) const { return this->busy_us_[talker]; }
+    uint64_t get_overlap_us() const { return this->overlap_us_; }
+
+  protected:
+    std::vector<WireListener*> listeners_;
+    bool driving_[TALKER_COUNT]{};
+    bool active_[TALKER_COUNT]{};
+    int low_count_{0};
+    uint64_t last_rise_us_{0};
+    uint64_t accounted_us_{0};
+    uint64_t busy_us_[TALKER_COUNT]{};
+    uint64_t overlap_us_{0};
+};
+
+/**
+ * @class SimPin
+ * @brief The GPIO of this component, wired to the virtual line.
+ *
+ * Writing low in output mode pulls the line, reads return the line in input mode, and the
+ * attached interrupt runs on every change of the line, like an ESP32 pin set to ANY_EDGE.
+ */
+class SimPin : public InternalGPIOPin, public WireListener {
+  public:
+    explicit SimPin(VirtualWire& wire) : wire_(wire) { wire.add_listener(this); }
+    ~SimPin() override { this->wire_.remove_listener(this); }
+
+    void pin_mode(gpio::Flags flags) override {
+        this->flags_ = flags;
+        this->apply();
+    }
+    bool digital_read() override {
+        return (this->flags_ & gpio::FLAG_INPUT) ? !this->wire_.is_low() : this->high_;
+    }
+    void digital_write(bool value) override {
+        this->high_ = value;
+        this->apply();
+    }
+    uint8_t get_pin() const override { return 4; }
+    ISRInternalGPIOPin to_isr() const override {
+        return ISRInternalGPIOPin(const_cast<SimPin*>(this));
+    }
+    void on_line(bool /*low*/, uint64_t /*now_us*/) override {
+        if (this->isr_ != nullptr && (this->flags_ & gpio::FLAG_INPUT)) this->isr_(this->isr_arg_);
+    }
+
+  protected:
+    VirtualWire& wire_;
+    gpio::Flags flags_{gpio::FLAG_NONE};
+    bool high_{true};
+    mutable void (*isr_)(void*){nullptr};
+    mutable void* isr_arg_{nullptr};
+
+    void attach_interrupt(
+        void (*func)(void*), void* arg, gpio::InterruptType /*type*/) const override {
+        this->isr_ = func;
+        this->isr_arg_ = arg;
+    }
+    void apply() {
+        bool output = this->flags_ & gpio::FLAG_OUTPUT;
+        this->wire_.set_active(TALKER_LOCAL, output);
+        this->wire_.drive(TALKER_LOCAL, output && !this->high_);
+    }
+};
+
+/**
+ * @brief Plays the levels of a TxEngine on the wire, one event per level.
+ */
+class Transmitter {
+  public:
+    Transmitter(VirtualWire& wire, talker_t talker) : wire_(wire), talker_(talker) {}
+    TxEngine& engine() { return this->engine_; }
+    bool is_active() const { return this->engine_.get_state() == TX_ENGINE_SENDING; }
+    uint64_t next_event_us() const { return this->is_active() ? this->next_us_ : sim_never_us; }
+
+    void start() {
+        this->engine_.start();
+        this->wire_.set_active(this->talker_, true);
+        this->next_us_ = host_clock().now_us();
+        this->step();
+    }
+    /**
+     * @brief Plays the next level, at the time the previous one ends.
+     * @return false Once all the levels were played.
+     */
+    bool step() {
+        tx_level_t level;
+        if (!this->engine_.next_level(level)) {
+            this->release();
+            return false;
+        }
+        this->wire_.drive(this->talker_, !level.high);
+        this->next_us_ += level.duration_us;
+        return true;
+    }
+    void abort() {
+        this->engine_.abort();
+        this->release();
+    }
+
+  protected:
+    VirtualWire& wire_;
+    talker_t talker_;
+    TxEngine engine_;
+    uint64_t next_us_{0};
+
+    void release() {
+        this->wire_.drive(this->talker_, false);
+        this->wire_.set_active(this->talker_, false);
+    }
+};
+
+/**
+ * @brief Turns the line changes into pulses and decodes them, like Bus::process_pulse().
+ */
+class LineDecoder {
+  public:
+    using frame_callback_t = std::function<void(const BaseFrame&)>;
+
+    explicit LineDecoder(frame_callback_t callback) : callback_(std::move(callback)) {}
+
+    void reset() {
+        this->decoder_.reset();
+        this->has_fall_ = false;
+        this->has_low_ = false;
+    }
+    FrameRegistry& registry() { return this->registry_; }
+
+    void on_line(bool low, uint64_t now_us) {
+        if (!low) {
+            this->rise_us_ = now_us;
+            this->has_low_ = this->has_fall_;
+            return;
+        }
+        if (this->has_low_) {
+            this->process_pulse(this->rise_us_ - this->fall_us_, now_us - this->rise_us_);
+        }
+        this->fall_us_ = now_us;
+        this->has_fall_ = true;
+        this->has_low_ = false;
+    }
+
+  protected:
+    Decoder decoder_;
+    heat_pump_data_t hp_data_{};
+    FrameRegistry registry_;
+    frame_callback_t callback_;
+    bool has_fall_{false};
+    bool has_low_{false};
+    uint64_t fall_us_{0};
+    uint64_t rise_us_{0};
+
+    void process_pulse(uint64_t low_us, uint64_t high_us) {
+        rmt_item32_t item{};
+        item.level0 = 0;
+        item.duration0 = std::min<uint64_t>(low_us, 0x7FFF);
+        item.level1 = 1;
+        item.duration1 = std::min<uint64_t>(high_us, 0x7FFF);
+        if (Decoder::is_start_frame(&item)) {
+            this->decoder_.start_new_frame();
+            return;
+        }
+        if (!this->decoder_.is_started()) return;
+        bool is_long = Decoder::is_long_bit(&item);
+        if (!is_long && !Decoder::is_short_bit(&item)) {
+            // a collision garbled the frame
+            this->decoder_.reset();
+            return;
+        }
+        this->decoder_.append_bit(is_long);
+        // the heater only takes configuration frames, all long ones: do not stop at nine
+        // bytes because their checksum happens to match
+        if (!this->decoder_.is_complete() || this->decoder_.size() < frame_data_length) return;
+        auto frame = this->decoder_.finalize(this->hp_data_, this->registry_);
+        this->decoder_.reset();
+        if (frame) this->callback_(*frame);
+    }
+};
+
+/**
+ * @class ControllerModel
+ * @brief The wall controller: sends its clock and configuration every minute, never listens.
+ */
+class ControllerModel {
+  public:
+    ControllerModel(VirtualWire& wire, std::mt19937& rng)
+        : rng_(rng), transmitter_(wire, TALKER_CONTROLLER) {
+        this->next_burst_us_ = (rng() % delay_between_controller_messages_ms) * 1000ULL;
+        this->frames_ = make_config_packets();
+        this->frames_.insert(this->frames_.begin(), make_packet(0xCF, 0x10));
+    }
+
+    uint64_t next_event_us() const {
+        return this->transmitter_.is_active() ? this->transmitter_.next_event_us()
+                                              : this->next_burst_us_;
+    }
+    void run(uint64_t now_us) {
+        if (this->transmitter_.is_active()) {
+            if (now_us >= this->transmitter_.next_event_us()) this->transmitter_.step();
+            return;
+        }
+        if (now_us < this->next_burst_us_) return;
+        TxEngine& engine = this->transmitter_.engine();
+        engine.clear();
+        append_burst(engine, this->frames_);
+        this->transmitter_.start();
+        std::uniform_int_distribution<int32_t> jitter(
+            -static_cast<int32_t>(controller_jitter_ms), controller_jitter_ms);
+        this->next_burst_us_ +=
+            (delay_between_controller_messages_ms + jitter(this->rng_)) * 1000LL;
+    }
+
+  protected:
+    std::mt19937& rng_;
+    Transmitter transmitter_;
+    std::vector<hp_packetdata_t> frames_;
+    uint64_t next_burst_us_;
+};
+
+/**
+ * @class HeaterModel
+ * @brief The heat pump: reports its conditions and configuration, and echoes new settings.
+ *
+ * Heater frames are sent with inverted bits. The configuration frames it receives are
+ * applied and echoed back shortly after, which is what the closed-loop transmitter and the
+ * command tracker wait for. The heater only starts talking on a quiet bus, and gives up the
+ * bus when someone else pulls the line low while it releases it.
+ */
+class HeaterModel : public WireListener {
+  public:
+    explicit HeaterModel(VirtualWire& wire)
+        : wire_(wire), transmitter_(wire, TALKER_HEATER),
+          decoder_([this](const BaseFrame& frame) { this->on_frame(frame); }) {
+        wire.add_listener(this);
+        this->status_.push_back(make_packet(FrameConditions1::FRAME_ID_CONDITIONS_1, 0x20));
+        this->status_.back().data[2] = 0x05; // reserved_1 of the regular conditions frame
+        this->status_.back().set_checksum();
+        this->status_.push_back(make_packet(FrameConditions2::FRAME_ID_CONDITIONS2, 0x30));
+        this->status_.push_back(make_packet(FrameConditionsD::FRAME_ID_COND_D, 0x40));
+        this->config_ = make_config_packets();
+    }
+    ~HeaterModel() override { this->wire_.remove_listener(this); }
+
+    uint64_t next_event_us() const {
+        uint64_t next = std::min(this->next_status_us_, this->next_config_us_);
+        if (this->collided_) return host_clock().now_us();
+        if (this->transmitter_.is_active()) {
+            return std::min(next, this->transmitter_.next_event_us());
+        }
+        if (!this->echoes_.empty()) next = std::min(next, this->echoes_.front().first);
+        if (!this->pending_.empty() && !this->wire_.is_low()) {
+            next = std::min(next, std::max(host_clock().now_us(),
+                                      this->wire_.get_last_rise_us() + this->idle_gap_ms_ * 1000));
+        }
+        return next;
+    }
+
+    void run(uint64_t now_us) {
+        if (this->transmitter_.is_active() && now_us >= this->transmitter_.next_event_us()) {
+            if (!this->transmitter_.step()) {
+                this->burst_.clear();
+            } else if (!this->wire_.is_driving(TALKER_HEATER) && this->wire_.is_low()) {
+                this->collided_ = true;
+            }
+        }
+        if (this->collided_) {
+            // someone else took the bus: back off and send it all again later
+            this->collided_ = false;
+            this->transmitter_.abort();
+            this->collisions_++;
+            this->pending_.insert(this->pending_.begin(), this->burst_.begin(), this->burst_.end());
+            this->burst_.clear();
+        }
+        if (now_us >= this->next_status_us_) {
+            for (const auto& packet : this->status_) this->push(packet);
+            this->next_status_us_ = now_us + heater_status_period_ms * 1000ULL;
+        }
+        if (now_us >= this->next_config_us_) {
+            for (const auto& packet : this->config_) this->push(packet);
+            this->next_config_us_ = now_us + heater_config_period_ms * 1000ULL;
+        }
+        while (!this->echoes_.empty() && now_us >= this->echoes_.front().first) {
+            this->push(this->echoes_.front().second);
+            this->echoes_.pop_front();
+        }
+        if (!this->transmitter_.is_active() && !this->pending_.empty() &&
+            !this->wire_.is_low() &&
+            now_us >= this->wire_.get_last_rise_us() + this->idle_gap_ms_ * 1000) {
+            this->start_burst();
+        }
+    }
+    void on_line(bool low, uint64_t now_us) override {
+        if (this->transmitter_.is_active()) {
+            // checked by run(), never from inside another talker's drive
+            if (low && !this->wire_.is_driving(TALKER_HEATER)) this->collided_ = true;
+            return;
+        }
+        this->decoder_.on_line(low, now_us);
+    }
+    uint32_t get_collisions() const { return this->collisions_; }
+    /// @brief Bursts started while another talker still held the bus, after its last frame.
+    uint32_t get_gap_bursts() const { return this->gap_bursts_; }
+    void set_idle_gap_ms(uint32_t idle_gap_ms) { this->idle_gap_ms_ = idle_gap_ms; }
+
+  protected:
+    VirtualWire& wire_;
+    Transmitter transmitter_;
+    LineDecoder decoder_;
+    std::vector<hp_packetdata_t> status_;
+    std::vector<hp_packetdata_t> config_;
+    std::deque<hp_packetdata_t> pending_;
+    std::vector<hp_packetdata_t> burst_;
+    std::deque<std::pair<uint64_t, hp_packetdata_t>> echoes_;
+    uint64_t next_status_us_{heater_status_period_ms * 1000ULL / 2};
+    uint64_t next_config_us_{heater_config_period_ms * 1000ULL / 3};
+    uint32_t idle_gap_ms_{heater_idle_gap_ms};
+    uint32_t collisions_{0};
+    uint32_t gap_bursts_{0};
+    bool collided_{false};
+
+    /// @brief Queues a frame, replacing the pending one of the same type.
+    void push(const hp_packetdata_t& packet) {
+        for (auto& pending : this->pending_) {
+            if (pending.get_type() == packet.get_type()) {
+                pending = packet;
+                return;
+            }
+        }
+        this->pending_.push_back(packet);
+    }
+
+    void start_burst() {
+        this->burst_.assign(this->pending_.begin(), this->pending_.end());
+        this->pending_.clear();
+        std::vector<hp_packetdata_t> inverted(this->burst_);
+        for (auto& packet : inverted) inverse(packet.data, packet.data_len);
+        TxEngine& engine = this->transmitter_.engine();
+        engine.clear();
+        append_burst(engine, inverted);
+        this->decoder_.reset();
+        for (size_t talker = 0; talker < TALKER_COUNT; talker++) {
+            if (talker != TALKER_HEATER && this->wire_.is_active(static_cast<talker_t>(talker))) {
+                this->gap_bursts_++;
+                break;
+            }
+        }
+        this->transmitter_.start();
+    }
+
+    void on_frame(const BaseFrame& frame) {
+        if (frame.get_source() != SOURCE_CONTROLLER) return;
+        for (auto& config : this->config_) {
+            if (config.get_type() != frame.packet.get_type()) continue;
+            if (config != frame.packet) {
+                config = frame.packet;
+                this->echoes_.push_back(
+                    {host_clock().now_us() + heater_echo_delay_ms * 1000ULL, config});
+            }
+            return;
+        }
+    }
+};
+
+/**
+ * @class SimNode
+ * @brief The PoolHeater component, with the hooks the simulation needs.
+ */
+class SimNode : public PoolHeater {
+  public:
+    explicit SimNode(InternalGPIOPin* pin) : PoolHeater(pin) {
+        this->set_actual_status_sensor(&this->status_sensor_);
+    }
+    using PoolHeater::dump_config;
+    using PoolHeater::setup;
+    Bus& bus() { return this->driver_; }
+
+  protected:
+    text_sensor::TextSensor status_sensor_;
+};
+
+typedef struct {
+    uint32_t seed;
+    bool adaptive_repeats;
+    bool collision_detect;
+} sim_config_t;
+
+/**
+ * @class SimWorld
+ * @brief Runs the wall controller, the heater and the real component on one virtual wire.
+ *
+ * Time jumps from one event to the next: a level change of a talker, an esp_timer of the
+ * bus, the wake-up of the decode worker, the main loop of ESPHome or a scheduled action.
+ * The decode worker is serviced right after the events that notify it, as the task would
+ * be woken up on the device. The main loop keeps its 16ms period after the worker or an
+ * action ran, and only runs every second when nothing happened since, which is what keeps
+ * the quiet hours cheap: only the command timeouts are then seen up to a second late.
+ */
+class SimWorld {
+  public:
+    /**
+     * @param flash The flash content to boot from, as left by a previous world, if any.
+     */
+    explicit SimWorld(const sim_config_t& config, const ESPPreferences* flash = nullptr)
+        : rng_(config.seed), controller_(wire_, rng_), heater_(wire_), pin_(wire_) {
+        host_seed_random(config.seed);
+        if (flash != nullptr) this->preferences_ = *flash;
+        global_preferences = &this->preferences_;
+        this->node_.reset(new SimNode(&this->pin_));
+        this->node_->set_passive_mode(false);
+        this->node_->set_adaptive_repeats(
+            config.adaptive_repeats, sim_repeat_group, sim_confirm_window_ms);
+        this->node_->set_collision_detect(
+            config.collision_detect, sim_collision_max_retries, sim_collision_backoff_ms);
+        this->node_->setup();
+    }
+
+    VirtualWire& wire() { return this->wire_; }
+    HeaterModel& heater() { return this->heater_; }
+    SimNode& node() { return *this->node_; }
+    ESPPreferences& preferences() { return this->preferences_; }
+    std::mt19937& rng() { return this->rng_; }
+    uint64_t now_us() const { return host_clock().now_us(); }
+
+    /// @brief Runs an action at the given time, from the main loop.
+    void at(uint64_t when_us, std::function<void()>&& action) {
+        this->actions_.emplace(when_us, std::move(action));
+    }
+    void run_for_ms(uint64_t duration_ms) { this->run_until(this->now_us() + duration_ms * 1000); }
+
+    void run_until(uint64_t end_us) {
+        VirtualClock& clock = host_clock();
+        for (;;) {
+            uint64_t next = std::min({end_us, this->controller_.next_event_us(),
+                this->heater_.next_event_us(), this->worker_due_us_, this->next_loop_us_,
+                this->next_update_us_});
+            uint64_t timer_us = sim_never_us;
+            host_next_timer_us(&timer_us);
+            next = std::min(next, timer_us);
+            if (!this->actions_.empty()) next = std::min(next, this->actions_.begin()->first);
+            if (next > clock.now_us()) clock.advance_us(next - clock.now_us());
+            uint64_t now = clock.now_us();
+            if (now >= end_us) return;
+
+            if (now >= timer_us) host_run_timers();
+            if (now >= this->controller_.next_event_us()) this->controller_.run(now);
+            if (now >= this->heater_.next_event_us()) this->heater_.run(now);
+            while (!this->actions_.empty() && this->actions_.begin()->first <= now) {
+                std::function<void()> action = std::move(this->actions_.begin()->second);
+                this->actions_.erase(this->actions_.begin());
+                action();
+                this->wake_loop();
+            }
+            if (now >= this->next_loop_us_) {
+                this->node_->loop();
+                this->last_loop_us_ = now;
+                this->next_loop_us_ = now + sim_idle_loop_interval_ms * 1000;
+            }
+            if (now >= this->next_update_us_) {
+                this->node_->update();
+                this->next_update_us_ = now + sim_update_interval_ms * 1000;
+            }
+            if (host_take_notification() || now >= this->worker_due_us_) {
+                uint32_t wait_ms = DecodeWorker::service_buses();
+                // the task waits one more tick than asked, see DecodeWorker::task()
+                this->worker_due_us_ = now + (wait_ms == 0 ? 0 : (wait_ms + 1) * 1000ULL);
+                this->wake_loop();
+            }
+        }
+    }
+
+  protected:
+    ESPPreferences preferences_;
+    std::mt19937 rng_;
+    VirtualWire wire_;
+    ControllerModel controller_;
+    HeaterModel heater_;
+    SimPin pin_;
+    std::unique_ptr<SimNode> node_;
+    std::multimap<uint64_t, std::function<void()>> actions_;
+    uint64_t worker_due_us_{0};
+    uint64_t next_loop_us_{0};
+    uint64_t last_loop_us_{0};
+    uint64_t next_update_us_{sim_update_interval_ms * 1000ULL};
+
+    void wake_loop() {
+        this->next_loop_us_ =
+            std::min(this->next_loop_us_, this->last_loop_us_ + sim_loop_interval_ms * 1000);
+    }
+};
+
+} // namespace hwp
+} // namespace esphome
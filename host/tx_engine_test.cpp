@@ -0,0 +1,172 @@
+/**
+ * @file tx_engine_test.cpp
+ * @brief Steps the TxEngine through send, listen and settle against a virtual clock.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "TxEngine.h"
+#include "virtual_clock.h"
+
+using namespace esphome::hwp;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                \
+            failures++;                                                                         \
+        }                                                                                       \
+    } while (0)
+
+static constexpr uint32_t confirm_window_ms = 250;
+static constexpr uint32_t settle_ms = 1200;
+
+/**
+ * @brief Builds the levels of a short frame the way Bus::send_frame() does.
+ */
+static void build_burst(TxEngine& engine) {
+    engine.clear();
+    engine.append_level(false, 9); // header
+    engine.append_level(true, 5);
+    for (int bit = 0; bit < 8; bit++) {
+        engine.append_level(false, 1);
+        engine.append_level(true, (bit & 1) ? 3 : 1);
+    }
+    engine.append_level(false, 1); // terminates the last bit
+}
+
+/**
+ * @brief Plays the levels like the step timer, returns the time spent on the line.
+ */
+static uint64_t play(TxEngine& engine, VirtualClock& clock) {
+    uint64_t start = clock.now_us();
+    tx_level_t level;
+    engine.start();
+    while (engine.next_level(level)) {
+        CHECK(engine.get_state() == TX_ENGINE_SENDING);
+        clock.advance_us(level.duration_us);
+    }
+    return clock.now_us() - start;
+}
+
+static void test_levels() {
+    TxEngine engine;
+    build_burst(engine);
+    // the header high merges with nothing, each bit adds a low and a high level
+    CHECK(engine.size() == 2 + 8 * 2 + 1);
+    CHECK(engine.get_duration_us() == (9 + 5 + 8 * 1 + 4 * 3 + 4 * 1 + 1) * 1000);
+    engine.append_level(false, 2);
+    CHECK(engine.size() == 2 + 8 * 2 + 1); // merged with the previous low
+    CHECK(engine.get_duration_us() == (9 + 5 + 8 * 1 + 4 * 3 + 4 * 1 + 1 + 2) * 1000);
+}
+
+static void test_send_listen_settle(uint64_t start_us) {
+    VirtualClock clock(start_us);
+    TxEngine engine;
+    CHECK(engine.is_idle());
+    build_burst(engine);
+
+    CHECK(play(engine, clock) == engine.get_duration_us());
+    CHECK(engine.get_state() == TX_ENGINE_SENT);
+
+    engine.wait_until(TX_ENGINE_LISTENING, clock.millis() + confirm_window_ms);
+    CHECK(engine.time_left(clock.millis()) == confirm_window_ms);
+    clock.advance_ms(confirm_window_ms - 1);
+    CHECK(engine.time_left(clock.millis()) == 1);
+    clock.advance_ms(1);
+    CHECK(engine.time_left(clock.millis()) == 0);
+
+    engine.wait_until(TX_ENGINE_SETTLING, clock.millis() + settle_ms);
+    CHECK(engine.get_state() == TX_ENGINE_SETTLING);
+    clock.advance_ms(settle_ms / 2);
+    CHECK(engine.time_left(clock.millis()) == settle_ms / 2);
+    clock.advance_ms(settle_ms);
+    CHECK(engine.time_left(clock.millis()) == 0); // passed deadlines stay at 0
+
+    engine.set_idle();
+    CHECK(engine.is_idle());
+}
+
+static void test_abort() {
+    VirtualClock clock;
+    TxEngine engine;
+    build_burst(engine);
+    engine.start();
+    tx_level_t level;
+    CHECK(engine.next_level(level));
+    CHECK(!level.high && level.duration_us == 9000);
+    clock.advance_us(level.duration_us);
+    engine.abort(); // collision detected on the next step
+    CHECK(engine.get_state() == TX_ENGINE_SENT);
+
+    // a new round restarts from the first level
+    CHECK(play(engine, clock) == engine.get_duration_us());
+    CHECK(engine.get_state() == TX_ENGINE_SENT);
+}
+
+static void test_readback() {
+    TxEngine engine;
+    build_burst(engine);
+    engine.end_readback();
+    engine.append_level(true, 250); // open-loop group spacing
+    engine.start();
+    tx_level_t level;
+    size_t read_back = 0;
+    while (engine.next_level(level)) {
+        if (engine.is_readback_level()) read_back++;
+    }
+    CHECK(read_back == engine.size() - 1);
+
+    // all the levels are read back until told otherwise
+    build_burst(engine);
+    engine.start();
+    while (engine.next_level(level)) CHECK(engine.is_readback_level());
+}
+
+int main() {
+    test_levels();
+    test_send_listen_settle(0);
+    // the deadlines straddle the 32 bits millis() wrap
+    test_send_listen_settle((static_cast<uint64_t>(UINT32_MAX) - 100) * 1000);
+    test_abort();
+    test_readback();
+    if (failures != 0) {
+        printf("%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All TxEngine checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file virtual_clock.h
+ * @brief Clock advanced by hand, standing in for esp_timer and millis() on the host.
+ *
+ * Copyright (c) 2024 S. Leclerc (sle118@hotmail.com)
+ *
+ * This file is part of the Pool Heater Controller component project.
+ *
+ * @project Pool Heater Controller Component
+ * @developer S. Leclerc (sle118@hotmail.com)
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @disclaimer Use at your own risk. The developer assumes no responsibility
+ * for any damage or loss caused by the use of this software.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace hwp {
+
+/**
+ * @class VirtualClock
+ * @brief Microseconds counter that only moves when told to.
+ *
+ * Like esp_timer_get_time() it counts microseconds on 64 bits, and millis() is truncated to
+ * 32 bits so it wraps like on the device. It can start anywhere, e.g. just before the wrap.
+ */
+class VirtualClock {
+  public:
+    explicit VirtualClock(uint64_t start_us = 0) : now_us_(start_us) {}
+
+    uint64_t now_us() const { return this->now_us_; }
+    uint32_t millis() const { return static_cast<uint32_t>(this->now_us_ / 1000); }
+    void advance_us(uint64_t us) { this->now_us_ += us; }
+    void advance_ms(uint32_t ms) { this->now_us_ += static_cast<uint64_t>(ms) * 1000; }
+
+  protected:
+    uint64_t now_us_;
+};
+
+} // namespace hwp
+} // namespace esphome